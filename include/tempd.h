@@ -68,6 +68,33 @@
  *
  *     Other options:
  *          --unixctl=SOCKET        override default control socket name
+ *          --replay=DIR            replay sensor traces from DIR in virtual
+ *                                  time, print transitions and exit
+ *          --hw-desc-dir=DIR       h/w description to use with --replay
+ *          --subsystem=NAME        subsystem name to use with --replay
+ *          --events=SOCKET         change event socket (default:
+ *                                  punix:/var/run/openvswitch/ops-tempd.events,
+ *                                  "none" to disable)
+ *          --standby-read-period=SECS  read sensors every SECS seconds
+ *                                  while in standby (default: 0, off)
+ *          --publish-stats         write rolling statistics to the db
+ *          --publish-samples       write sample times and read quality to
+ *                                  the db
+ *          --state-file=FILE       warm-restart state file (default:
+ *                                  /var/run/openvswitch/ops-tempd.state,
+ *                                  "none" to disable)
+ *          --flight-recorder=FILE  binary log of every reading (default:
+ *                                  /var/log/openvswitch/ops-tempd.rec,
+ *                                  "none" to disable)
+ *          --emergency-action=ACTION  "poweroff" (default), or the
+ *                                  absolute path of a stub to run in
+ *                                  place of poweroff (reboot() isn't
+ *                                  called either)
+ *          --simulated-shutdown    let test and injected temperatures
+ *                                  start an emergency shutdown
+ *          --bus-lock-dir=DIR      directory of i2c bus lock files shared
+ *                                  with other daemons (default: the OVS
+ *                                  run directory, "none" to disable)
  *          -h, --help              display this help message
  *          -V, --version           display version information
  *
@@ -75,6 +102,34 @@
  * ovs-apptcl options:
  *
  *      Support dump: ovs-appctl -t ops-tempd ops-tempd/dump
+ *      JSON dump: ovs-appctl -t ops-tempd ops-tempd/dump-json [TARGET [FIELDS]]
+ *          TARGET is a subsystem name or a sensor name pattern (default: *)
+ *          FIELDS is a comma separated list of: subsystem, location,
+ *          device, type, status, fan_state, temperature, min, max,
+ *          fault_count, breaker, stats, thresholds, sample, transitions
+ *          (default: all)
+ *      Test temperature: ovs-appctl -t ops-tempd ops-tempd/test SENSOR TEMP
+ *      Reload thresholds: ovs-appctl -t ops-tempd ops-tempd/reload [SUBSYSTEM]
+ *          re-reads alarm and fan thresholds from the h/w description (and
+ *          composite thresholds from tempd.json), without resetting state
+ *      Inject profile: ovs-appctl -t ops-tempd ops-tempd/inject
+ *                          PROFILE TARGET [DURATION ARGS...]
+ *          step TARGET SECONDS TEMP
+ *          ramp TARGET SECONDS FROM TO
+ *          sine TARGET SECONDS MEAN AMPLITUDE PERIOD
+ *          walk TARGET SECONDS START STEP
+ *          clear TARGET
+ *          TARGET is a subsystem name or a sensor name pattern
+ *          (wildcards allowed). Temperatures are in degrees C.
+ *
+ * Change events:
+ *
+ *      Clients connected to the events socket (--events) receive one json
+ *      line per sensor whose status, fan state or temperature changed:
+ *          {"sensor":NAME,"status":S,"fan_state":F,"temperature":MILIDEG}
+ *      and may send the following lines:
+ *          deadband MILIDEGREES    only report temperature changes this big
+ *          filter PATTERN          only report matching sensors
  *
  *
  * OVSDB elements usage
@@ -93,6 +148,14 @@
  *              Temp_sensor:temperature
  *              Temp_sensor:fan_state
  *              Temp_sensor:status
+ *              Temp_sensor:external_ids:stats_1m, stats_15m, stats_24h
+ *                  ("min,avg,max" in milidegrees, with --publish-stats)
+ *              Temp_sensor:external_ids:sample_time, sample_quality
+ *                  (wall clock time of the last good sample in msec, and
+ *                  where the value came from, with --publish-samples)
+ *              Temp_sensor:external_ids:fan_duty
+ *                  (requested fan duty in %, for sensors with a "fan_duty"
+ *                  controller in tempd.json)
  *              daemon["ops-tempd"]:cur_hw
  *              subsystem:temp_sensors
  *
@@ -107,6 +170,10 @@
  *           daemon
  *           /var/run/openvswitch/ops-tempd.<pid>.ctl: unixctl socket for the Temperature
  *           daemon
+ *           /var/run/openvswitch/ops-tempd.state: per-sensor state, restored
+ *           when the Temperature daemon restarts
+ *           /var/log/openvswitch/ops-tempd.rec[.N]: flight recorder, decoded
+ *           with ops-tempd-recdump
  *
  * @}
  ***************************************************************************/
@@ -114,6 +181,11 @@
 #ifndef _TEMPD_H_
 #define _TEMPD_H_
 
+#include "tempd_stats.h"
+#include "tempd_state.h"
+#include "tempd_recorder.h"
+#include "tempd_i2c_lock.h"
+
 VLOG_DEFINE_THIS_MODULE(ops_tempd);
 
 COVERAGE_DEFINE(tempd_reconfigure);
@@ -123,6 +195,9 @@ COVERAGE_DEFINE(tempd_reconfigure);
 #define POLLING_PERIOD  5
 #define MSEC_PER_SEC    1000
 
+// polling period used when every sensor has a hardware alert wired up
+#define ALERT_POLLING_PERIOD    30
+
 #define DEFAULT_TEMP    35
 #define MILI_DEGREES    1000
 #define MILI_DEGREES_FLOAT  1000.0
@@ -176,12 +251,304 @@ struct locl_subsystem {
     struct locl_subsystem *parent_subsystem;    // pointer to parent (if any)
     struct shash subsystem_sensors;     // sensors in this subsystem
     bool emergency_shutdown;            // flag - shutdown if emergency overtemp
+    struct json *ext;                   // tempd extensions (or NULL)
+    char *hw_desc_dir;                  // h/w description directory
+    bool published;         // flag - sensors have been added to the db
+    struct locl_sensor **composites;    // composite sensors, in evaluation
+    size_t n_composites;                // order (inputs first)
+    struct locl_peergroup **peer_groups;
+    size_t n_peer_groups;
+};
+
+// where a sensor's current temperature came from, in increasing order of
+// doubt
+enum readquality {
+    READ_QUALITY_OK = 0,        // read from the hardware
+    READ_QUALITY_SIMULATED = 1, // test override, injected or replayed
+    READ_QUALITY_DEFAULT = 2,   // unrecognized sensor type, not read
+    READ_QUALITY_HELD = 3,      // last read failed, previous value kept
+    READ_QUALITY_FAILED = 4     // sensor has failed (status "fault")
+};
+
+// must match readquality enum
+const char *read_quality[] = {
+    "ok",
+    "simulated",
+    "default",
+    "held",
+    "failed"
+};
+
+// i2c circuit breaker state (per device and per bus)
+enum breakerstate {
+    BREAKER_CLOSED = 0,     // reads allowed
+    BREAKER_OPEN = 1,       // reads skipped until the next probe time
+    BREAKER_HALF_OPEN = 2   // one probe read allowed
+};
+
+// must match breakerstate enum
+const char *breaker_state[] = {
+    "closed",
+    "open",
+    "half-open"
+};
+
+struct locl_breaker {
+    enum breakerstate state;
+    int failures;           // consecutive failed (or slow) reads
+    int backoff;            // current backoff (msec)
+    long long int next_probe;           // time_msec() of next probe read
+    unsigned int trips;     // number of times the breaker has opened
+};
+
+// lock shared with other daemons for one i2c bus (and the mux segments
+// behind it), see tempd_i2c_lock.h
+struct locl_buslock {
+    char *name;
+    int fd;                 // -1 if not open (yet)
+    bool window;            // transfers are in progress this poll
+    bool held;              // the lock was acquired for this window
+    unsigned int windows;   // number of windows opened
+    unsigned int timeouts;  // windows that went ahead without the lock
+    long long int wait_msec;            // total time spent waiting
+    struct locl_bus **buses;            // buses sharing this lock
+    size_t n_buses;
+};
+
+// i2c bus shared by one or more sensors (freed with its last sensor)
+struct locl_bus {
+    char *name;
+    struct locl_breaker breaker;
+    char *recovery;         // bus recovery command (or NULL)
+    pid_t recovery_pid;     // running recovery command (or 0)
+    unsigned int recoveries;
+    struct locl_buslock *lock;          // lock taken for transfers
+    struct locl_sensor **sensors;       // sensors on the bus
+    size_t n_sensors;
+};
+
+// recorded temperature trace, replayed in virtual time (see --replay)
+struct locl_trace {
+    size_t n;               // number of samples
+    size_t pos;             // current sample
+    long long int *msec;    // sample times (msec from start of trace)
+    int *temp;              // milidegrees (C), or TRACE_FAULT
+    // last values that would have been written to the db
+    enum sensorstatus status;
+    enum fanspeed fan_speed;
+    int temp_db;
+    int min_db;
+    int max_db;
+    bool published;
+};
+
+// trace sample value for a failed read
+#define TRACE_FAULT INT_MIN
+
+// injected temperature profiles (see ops-tempd/inject)
+enum injectprofile {
+    INJECT_STEP = 0,        // constant temperature
+    INJECT_RAMP = 1,        // linear from one temperature to another
+    INJECT_SINE = 2,        // sine wave around a mean
+    INJECT_WALK = 3         // random walk from a starting temperature
+};
+
+// must match injectprofile enum
+const char *inject_profile[] = {
+    "step",
+    "ramp",
+    "sine",
+    "walk"
+};
+
+struct locl_inject {
+    enum injectprofile profile;
+    long long int start;    // time_msec() the profile started
+    long long int duration; // msec
+    double arg[3];          // profile arguments (degrees C, seconds)
+    double walk;            // current random walk value (degrees C)
+};
+
+// composite sensor operations (see "composites" in TEMPD_EXT_FILE)
+enum compositeop {
+    COMPOSITE_MAX = 0,      // hottest input
+    COMPOSITE_MIN = 1,      // coolest input
+    COMPOSITE_AVG = 2,      // mean of the inputs
+    COMPOSITE_DELTA = 3     // first input minus the second input
+};
+
+// must match compositeop enum
+const char *composite_op[] = {
+    "max",
+    "min",
+    "avg",
+    "delta"
+};
+
+enum dutymode {
+    DUTY_CURVE = 0,         // piecewise linear in the temperature
+    DUTY_PI = 1             // proportional-integral around a setpoint
+};
+
+// must match dutymode enum
+const char *duty_mode[] = {
+    "curve",
+    "pi"
+};
+
+// continuous fan duty request computed from a sensor's temperature, in
+// addition to the discrete fan state
+struct locl_fanduty {
+    enum dutymode mode;
+    double *curve_temp;     // curve points: degrees C (increasing) ...
+    double *curve_duty;     // ... and duty (%)
+    size_t n_points;
+    double setpoint;        // pi: target temperature (degrees C)
+    double kp;              // pi: % per degree C of error
+    double ki;              // pi: % per degree C of error per second
+    double trend;           // % per degree C per minute of rise
+    double min_duty;        // output limits (%)
+    double max_duty;
+    double integral;        // pi: integral term (%)
+    double slope;           // smoothed rate of rise (degrees C per minute)
+    bool primed;            // last_temp/last_msec are set
+    int last_temp;
+    long long int last_msec;
+    double duty;            // current request (%)
+    int published;          // value last written to the db (-1 = none)
+};
+
+enum lm75variant {
+    LM75_VARIANT_LM75 = 0,  // 9 bits, continuous conversion only
+    LM75_VARIANT_LM75B = 1, // 11 bits, continuous conversion only
+    LM75_VARIANT_TMP75 = 2  // 9 to 12 bits, continuous or one-shot
+};
+
+// must match lm75variant enum
+const char *lm75_variant[] = {
+    "lm75",
+    "lm75b",
+    "tmp75"
+};
+
+// lm75-family device settings
+struct locl_lm75 {
+    enum lm75variant variant;
+    int resolution;         // bits in the temperature register
+    uint8_t conf;           // configuration register as configured (a
+                            // one-shot trigger sets LM75_CONF_ONE_SHOT)
+    bool one_shot;          // convert on request only (reads return the
+                            // conversion started by the previous read)
+    long long int triggered_msec;       // last conversion started
+};
+
+// a sensor in a snapshot. strings are offsets in the snapshot's string
+// pool.
+struct snapshot_sensor {
+    size_t name;
+    size_t subsystem;
+    size_t location;
+    size_t device;
+    size_t type;
+    size_t json_info;
+    size_t json_thresholds;
+    size_t text_info;
+    size_t text_config;
+    enum sensorstatus status;
+    enum fanspeed fan_speed;
+    bool has_duty;
+    double duty;
+    enum dutymode duty_mode;
+    double duty_slope;
+    int duty_published;
+    int temp;
+    int min;
+    int max;
+    int fault_count;
+    unsigned int logged;
+    unsigned int suppressed;
+    enum readquality quality;
+    long long int sampled;  // wall clock time of the last good sample
+                            // (msec, -1 = none)
+    unsigned int implausible;
+    bool composite;
+    int max_rate;
+    size_t peers;
+    bool alert;
+    struct locl_breaker breaker;
+    int read_msec;
+    struct stats_result stats[STATS_N_WINDOWS];
+    bool injected;
+    enum injectprofile inject_profile;
+    long long int inject_until; // wall clock time (msec)
+};
+
+// copy of the sensor state, taken after a change, that read-only queries
+// are served from. a snapshot is never modified once it's taken (except
+// to cache replies rendered from it). queries hold a reference, so a
+// newer snapshot can be swapped in while an older one is still in use.
+struct tempd_snapshot {
+    struct ovs_refcount ref_cnt;
+    unsigned int seqno;     // state_seqno it was taken at
+    long long int msec;     // when it was taken
+    long long int heartbeat;    // wall clock time of the last poll (msec)
+    size_t text_header;     // support dump text before and after the
+    size_t text_buses;      // sensors (offsets in the string pool)
+    struct snapshot_sensor *sensors;
+    size_t n_sensors;
+    char *strings;          // string pool
+    struct smap replies;    // rendered replies, by query
+};
+
+// sensors that should read about the same temperature (e.g. sensors in
+// the same airflow zone)
+struct locl_peergroup {
+    char *name;
+    int max_spread;         // milidegrees (from the mean of the peers)
+    long long int sum;      // sum of the members' last plausible readings
+    int n_valid;            // members with a plausible reading
+};
+
+// plausibility check state for a sensor's readings
+struct locl_plausibility {
+    int max_rate;           // milidegrees per second (0 = unchecked)
+    struct locl_peergroup *group;       // peer group (or NULL)
+    bool valid;             // a reading has been accepted
+    int last_temp;          // last plausible reading (milidegrees)
+    long long int last_msec;            // ... and when it was read
+    int candidate;          // step change waiting to be confirmed
+    int confirms;           // consecutive readings that agree with it
+    unsigned int rejected;  // implausible readings
+};
+
+// sensor transitions as logged. a transition (status, fan speed or read
+// failure) is logged once; a sensor that keeps changing is rate limited,
+// and the transitions that weren't logged are counted.
+struct locl_sensorlog {
+    enum sensorstatus status;   // state as of the last transition
+    enum fanspeed fan_speed;
+    bool faulted;
+    bool unrecognized;          // unknown sensor type has been logged
+    long long int period_start; // current rate limit period (msec)
+    unsigned int period_count;  // transitions logged in it
+    unsigned int logged;
+    unsigned int suppressed;
+    unsigned int unreported;    // suppressed since the last one logged
+};
+
+// virtual sensor computed from other sensors in the same subsystem
+struct locl_composite {
+    enum compositeop op;
+    struct locl_sensor **inputs;
+    size_t n_inputs;
+    bool dirty;             // an input changed since the last evaluation
 };
 
 struct locl_sensor {
     char *name;             // name of sensor ([subsystem name]-[sensor number])
     struct locl_subsystem *subsystem;   // containing subsystem
-    const YamlSensor *yaml_sensor;      // sensor information
+    YamlSensor *yaml_sensor;            // sensor information (own copy, so
+                                        // thresholds can be reloaded)
     enum sensorstatus status;           // current status result
     enum fanspeed fan_speed;            // current speed result
     int temp;               // milidegrees (C)
@@ -189,19 +556,169 @@ struct locl_sensor {
     int max;                // milidegrees (C)
     int fault_count;
     int test_temp;          // -1 or milidegrees (C)
+    const struct shash *ext;            // sensor extensions (or NULL)
+    int alert_fd;           // -1 or fd polled for over-temp alerts
+    struct locl_breaker breaker;        // device circuit breaker
+    struct locl_bus *bus;               // bus the device is on (or NULL)
+    int read_msec;          // duration of the last i2c read
+    struct locl_trace *trace;           // replayed trace (or NULL)
+    struct locl_inject *inject;         // injected profile (or NULL)
+    char *json_info;        // cached json for location/device/type
+    char *json_thresholds;  // cached json for thresholds
+    char *text_info;        // cached support dump text for the hardware
+    char *text_config;      // cached support dump text for the definition
+                            // and thresholds
+    struct stats_window stats[STATS_N_WINDOWS];    // rolling statistics
+    int state_slot;         // -1 or slot in the warm-restart state file
+    struct locl_composite *composite;   // composite definition (or NULL)
+    struct locl_sensor **dependents;    // composites that use this sensor
+    size_t n_dependents;
+    int recorder_id;        // flight recorder sensor id (0 = not yet known)
+    struct locl_plausibility plausibility;
+    struct locl_fanduty *duty;          // fan duty controller (or NULL)
+    struct locl_lm75 lm75;              // lm75 settings (lm75 type only)
+    struct locl_sensorlog log;          // logged transitions
+    long long int sample_msec;          // last good sample (-1 = none)
+    enum readquality quality;           // quality of the current value
+    int published_quality;              // -1 or quality in the db
+    // state as of the previous poll (for change events)
+    enum sensorstatus prev_status;
+    enum fanspeed prev_fan_speed;
+    int prev_temp;
+};
+
+// client of the change event socket (see --events)
+struct locl_subscriber {
+    struct stream *stream;
+    int deadband;           // min temperature change to report (milidegrees)
+    char *filter;           // sensor name pattern (or NULL for all)
+    struct simap sent_temp; // last temperature sent, per sensor
+    struct sset pending;    // sensors with unsent changes
+    struct ds out;          // rendered events not yet sent
+    struct ds in;           // partial command line from the client
+    unsigned int dropped;   // events coalesced because the client was slow
 };
 
+// rendered events buffered per subscriber before changes are coalesced
+#define SUBSCRIBER_MAX_OUT  65536
+
+// how often rolling statistics are written to the db (with --publish-stats)
+#define STATS_PUBLISH_PERIOD    60
+
+// how often the flight recorder's buffer is written out
+#define RECORDER_FLUSH_PERIOD   60
+
 // i2c operation failure retry
 #define MAX_FAIL_RETRY  2
 
+// smallest fan duty change (%) written to the db, and the weight of a new
+// sample in the smoothed rate of rise
+#define DUTY_DEADBAND       2
+#define DUTY_SLOPE_WEIGHT   0.3
+
+// most sensor transitions logged per sensor per SENSORLOG_PERIOD seconds
+#define SENSORLOG_BURST     5
+#define SENSORLOG_PERIOD    60
+
+// how often sample times are written to the db (with --publish-samples)
+#define SAMPLE_PUBLISH_PERIOD   30
+
+// most distinct query replies cached per snapshot
+#define SNAPSHOT_MAX_REPLIES    16
+
+// default limit on the rate of change of a sensor (degrees C per second),
+// and the allowance for sensor resolution and noise (milidegrees)
+#define PLAUSIBLE_MAX_RATE  5
+#define PLAUSIBLE_SLACK     1000
+
+// consecutive readings (within PLAUSIBLE_SLACK of each other) needed to
+// accept a step change that no peer sensor confirms
+#define PLAUSIBLE_CONFIRM   3
+
+// i2c reads that take longer than this are treated as failures
+#define I2C_READ_TIMEOUT_MSEC   100
+
+// circuit breaker backoff limits (doubled on every failed probe)
+#define BREAKER_BACKOFF_MIN_MSEC    (POLLING_PERIOD * MSEC_PER_SEC)
+#define BREAKER_BACKOFF_MAX_MSEC    (600 * MSEC_PER_SEC)
+
+// consecutive failures, across all devices on a bus, that open the bus
+#define BUS_FAIL_THRESHOLD  4
+
+// longest wait for a shared bus lock before reading without it
+#define BUS_LOCK_TIMEOUT_MSEC   250
+
+// optional per-subsystem file (in hw_desc_dir) with tempd-specific
+// sensor settings that are not part of the hw description schema
+#define TEMPD_EXT_FILE  "tempd.json"
+
+// lm75 register map
+#define LM75_REG_TEMP   0
+#define LM75_REG_CONF   1
+#define LM75_REG_THYST  2
+#define LM75_REG_TOS    3
+
+// lm75 configuration register (tmp75 resolution and one-shot bits)
+#define LM75_CONF_SHUTDOWN      0x01
+#define LM75_CONF_RES_SHIFT     5
+#define LM75_CONF_RES_MASK      0x60
+#define LM75_CONF_ONE_SHOT      0x80
+
+// lm75 resolutions (bits), and the tmp75 conversion time for a resolution
+// (27.5 msec at 9 bits, doubling with each bit)
+#define LM75_RESOLUTION_MIN     9
+#define LM75_RESOLUTION_MAX     12
+#define LM75_CONV_MSEC(bits)    (28 << ((bits) - LM75_RESOLUTION_MIN))
+
 // command to execute if emergency threshold temperature is reached
+// (executed directly, without a shell)
 // CAUTION: "off" is not an implemented power state for some switches:
 // this may result in a system needing to be powered off completely,
 // including removing the power supplies for several minutes to reset
 // the state. If the module has no power button, there's no way to turn
 // it back on! It may be best to disable the emergency power off in the
 // subsystem thermal data if this is the case.
-#define EMERGENCY_POWEROFF  "/sbin/poweroff --poweroff --force --no-wtmp"
+#define EMERGENCY_POWEROFF  "/sbin/poweroff", "--poweroff", "--force", "--no-wtmp"
+
+// emergency shutdown stages, in order (must match shutdown_stage array)
+enum shutdownstage {
+    SHUTDOWN_RECORD = 0,    // log, flush the flight recorder and state file
+    SHUTDOWN_NOTIFY = 1,    // write the sensor status to the db
+    SHUTDOWN_POWEROFF = 2,  // run EMERGENCY_POWEROFF
+    SHUTDOWN_ESCALATE = 3,  // reboot(RB_POWER_OFF) if still running
+    SHUTDOWN_N_STAGES = 4
+};
+
+// must match shutdownstage enum
+const char *shutdown_stage[] = {
+    "record",
+    "notify",
+    "poweroff",
+    "escalate"
+};
+
+// what the power off stages do (see --emergency-action)
+enum emergencyaction {
+    EMERGENCY_ACTION_POWEROFF = 0,
+    EMERGENCY_ACTION_STUB = 1   // run a stub in place of the power off
+                                // command, skip reboot(), keep running
+};
+
+struct locl_shutdown {
+    char *sensor;           // sensor that triggered the shutdown (or NULL)
+    long long int start;    // time_msec() the shutdown started
+    bool ran[SHUTDOWN_N_STAGES];
+    int msec[SHUTDOWN_N_STAGES];        // time taken by each stage
+    int rc[SHUTDOWN_N_STAGES];          // errno value (0 = ok)
+};
+
+// time budget for each stage (msec). stages that overrun are not
+// interrupted, but optional stages are skipped once the record and
+// notify budgets are used up.
+#define SHUTDOWN_RECORD_BUDGET_MSEC     1000
+#define SHUTDOWN_NOTIFY_BUDGET_MSEC     500
+// time to wait for EMERGENCY_POWEROFF to take effect before escalating
+#define SHUTDOWN_POWEROFF_DEADLINE_MSEC 10000
 
 #endif /* _TEMPD_H_ */
 
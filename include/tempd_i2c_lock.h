@@ -0,0 +1,49 @@
+/*
+ * (c) Copyright 2016 Hewlett Packard Enterprise Development LP
+ *
+ *    Licensed under the Apache License, Version 2.0 (the "License"); you may
+ *    not use this file except in compliance with the License. You may obtain
+ *    a copy of the License at
+ *
+ *         http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *    Unless required by applicable law or agreed to in writing, software
+ *    distributed under the License is distributed on an "AS IS" BASIS, WITHOUT
+ *    WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied. See the
+ *    License for the specific language governing permissions and limitations
+ *    under the License.
+ */
+
+/************************************************************************//**
+ * @ingroup ops-tempd
+ *
+ * @file
+ * Shared i2c bus locks
+ *
+ * Platform daemons that access the same i2c buses (ops-tempd, ops-fand,
+ * ops-powerd, ops-ledd, ...) take turns on a bus by holding an advisory
+ * lock on a per-bus lock file:
+ *
+ *     <dir>/i2c-<bus name>.lock      ('/' in the bus name becomes '_')
+ *
+ * where <dir> is normally the OVS run directory. A daemon locks the file
+ * (flock(LOCK_EX)) before a batch of transfers on the bus, does all of
+ * its transfers for that bus (grouped by mux segment) and unlocks it.
+ * Buses behind the same mux share one lock (named after the parent bus),
+ * so a daemon never changes a mux setting another daemon depends on.
+ *
+ * A lock should not be held for longer than I2C_LOCK_HOLD_MAX_MSEC.
+ * Waits are bounded: a daemon that can't get a lock in time goes ahead
+ * without it, since the locks only reduce contention.
+ ***************************************************************************/
+
+#ifndef _TEMPD_I2C_LOCK_H_
+#define _TEMPD_I2C_LOCK_H_
+
+#define I2C_LOCK_HOLD_MAX_MSEC  100
+
+int tempd_i2c_lock_open(const char *dir, const char *name);
+int tempd_i2c_lock_acquire(int fd, int timeout_msec);
+void tempd_i2c_lock_release(int fd);
+
+#endif /* _TEMPD_I2C_LOCK_H_ */
@@ -0,0 +1,91 @@
+/*
+ * (c) Copyright 2016 Hewlett Packard Enterprise Development LP
+ *
+ *    Licensed under the Apache License, Version 2.0 (the "License"); you may
+ *    not use this file except in compliance with the License. You may obtain
+ *    a copy of the License at
+ *
+ *         http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *    Unless required by applicable law or agreed to in writing, software
+ *    distributed under the License is distributed on an "AS IS" BASIS, WITHOUT
+ *    WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied. See the
+ *    License for the specific language governing permissions and limitations
+ *    under the License.
+ */
+
+/************************************************************************//**
+ * @ingroup ops-tempd
+ *
+ * @file
+ * Flight recorder
+ *
+ * Every raw reading and every status/fan transition is appended to a
+ * compact binary log, so that the lead up to a thermal shutdown can be
+ * reconstructed afterwards. The log is written through a stdio buffer,
+ * flushed periodically and before an emergency power off, and rotated
+ * when it reaches TEMPD_RECORDER_MAX_SIZE (keeping TEMPD_RECORDER_FILES
+ * files: FILE, FILE.1, ...).
+ *
+ * A file is a tempd_recorder_header followed by records. Every record
+ * starts with a tag byte; numbers are unsigned LEB128 varints, and signed
+ * numbers are zigzag encoded first:
+ *
+ *     REC_SENSOR   id, length, name       (defines a sensor id)
+ *     REC_TIME     msec since the previous REC_TIME (or the file start)
+ *     REC_TEMP     id, milidegrees minus the sensor's previous REC_TEMP
+ *     REC_FAULT    id                     (failed read)
+ *     REC_STATE    id, status, fan speed  (enum sensorstatus/fanspeed)
+ *     REC_SHUTDOWN id                     (emergency power off)
+ *
+ * Each file is self-contained: sensors are redefined, and temperatures
+ * start again from 0, after a rotation. A steady sensor costs 3 bytes
+ * per reading.
+ ***************************************************************************/
+
+#ifndef _TEMPD_RECORDER_H_
+#define _TEMPD_RECORDER_H_
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#define TEMPD_RECORDER_MAGIC    0x54524543      // "TREC"
+#define TEMPD_RECORDER_VERSION  1
+
+#define TEMPD_RECORDER_MAX_SIZE (1024 * 1024)
+#define TEMPD_RECORDER_FILES    4
+
+enum recordertag {
+    REC_SENSOR = 1,
+    REC_TIME = 2,
+    REC_TEMP = 3,
+    REC_FAULT = 4,
+    REC_STATE = 5,
+    REC_SHUTDOWN = 6
+};
+
+struct tempd_recorder_header {
+    uint32_t magic;
+    uint32_t version;
+    int64_t start;              // wall clock time the file was started (msec)
+};
+
+struct tempd_recorder_stats {
+    unsigned long long int readings;    // REC_TEMP and REC_FAULT records
+    unsigned long long int bytes;       // bytes written (all files)
+    unsigned int rotations;
+};
+
+int tempd_recorder_open(const char *path);
+void tempd_recorder_close(void);
+bool tempd_recorder_is_open(void);
+int tempd_recorder_sensor(const char *name);
+void tempd_recorder_time(long long int now);
+void tempd_recorder_temp(int id, int temp);
+void tempd_recorder_fault(int id);
+void tempd_recorder_state(int id, int status, int fan_speed);
+void tempd_recorder_shutdown(int id);
+void tempd_recorder_flush(bool sync);
+void tempd_recorder_get_stats(struct tempd_recorder_stats *stats);
+
+#endif /* _TEMPD_RECORDER_H_ */
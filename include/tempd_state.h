@@ -0,0 +1,87 @@
+/*
+ * (c) Copyright 2016 Hewlett Packard Enterprise Development LP
+ *
+ *    Licensed under the Apache License, Version 2.0 (the "License"); you may
+ *    not use this file except in compliance with the License. You may obtain
+ *    a copy of the License at
+ *
+ *         http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *    Unless required by applicable law or agreed to in writing, software
+ *    distributed under the License is distributed on an "AS IS" BASIS, WITHOUT
+ *    WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied. See the
+ *    License for the specific language governing permissions and limitations
+ *    under the License.
+ */
+
+/************************************************************************//**
+ * @ingroup ops-tempd
+ *
+ * @file
+ * Warm-restart state file
+ *
+ * Per-sensor state is checkpointed into a small, memory mapped file after
+ * every poll, so that a restarted ops-tempd can pick up where the previous
+ * one left off (min/max, alarm and fan hysteresis state, fault count)
+ * instead of starting from scratch. Writes are plain memory stores; the
+ * kernel writes the pages back.
+ *
+ * The file starts with a header (magic, version, record size), followed
+ * by fixed size records. A file with a different version or record size
+ * is discarded. Records have spare room for new fields: add them at the
+ * end of struct tempd_state_record (taking from "spare"), and bump
+ * TEMPD_STATE_VERSION if existing fields change meaning.
+ *
+ * The header also carries a heartbeat, updated after every poll, so that
+ * local consumers can tell that ops-tempd is still polling (and each
+ * record the time of the sensor's last good sample) without asking it.
+ ***************************************************************************/
+
+#ifndef _TEMPD_STATE_H_
+#define _TEMPD_STATE_H_
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#define TEMPD_STATE_MAGIC       0x54454d50      // "TEMP"
+#define TEMPD_STATE_VERSION     2
+#define TEMPD_STATE_NAME_LEN    64
+
+// saved state older than this is not restored (msec)
+#define TEMPD_STATE_MAX_AGE     (10 * 60 * 1000)
+
+struct tempd_state_header {
+    uint32_t magic;
+    uint32_t version;
+    uint32_t record_size;
+    uint32_t n_records;         // capacity, in records
+    int64_t heartbeat;          // wall clock time of the last poll (msec)
+    uint64_t polls;             // polls since ops-tempd started
+};
+
+struct tempd_state_record {
+    char name[TEMPD_STATE_NAME_LEN];    // sensor name ("" = free)
+    int64_t saved;              // wall clock time of last save (msec)
+    int32_t temp;               // milidegrees (C)
+    int32_t min;
+    int32_t max;
+    uint8_t status;             // enum sensorstatus
+    uint8_t fan_speed;          // enum fanspeed
+    uint16_t fault_count;
+    int64_t sampled;            // wall clock time of the last good sample
+                                // (msec, -1 = none)
+    uint8_t quality;            // enum readquality
+    uint8_t pad[3];
+    int32_t spare[13];          // room for new fields
+};
+
+int tempd_state_open(const char *path);
+void tempd_state_close(void);
+void tempd_state_sync(void);
+bool tempd_state_is_open(void);
+int tempd_state_slot(const char *name);
+struct tempd_state_record *tempd_state_record(int slot);
+void tempd_state_free(int slot);
+void tempd_state_heartbeat(long long int now);
+
+#endif /* _TEMPD_STATE_H_ */
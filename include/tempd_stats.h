@@ -0,0 +1,76 @@
+/*
+ * (c) Copyright 2016 Hewlett Packard Enterprise Development LP
+ *
+ *    Licensed under the Apache License, Version 2.0 (the "License"); you may
+ *    not use this file except in compliance with the License. You may obtain
+ *    a copy of the License at
+ *
+ *         http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *    Unless required by applicable law or agreed to in writing, software
+ *    distributed under the License is distributed on an "AS IS" BASIS, WITHOUT
+ *    WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied. See the
+ *    License for the specific language governing permissions and limitations
+ *    under the License.
+ */
+
+/************************************************************************//**
+ * @ingroup ops-tempd
+ *
+ * @file
+ * Rolling-window temperature statistics
+ *
+ * A window covers a fixed span of time (e.g. the last 15 minutes), split
+ * into STATS_BUCKETS buckets. Each sample updates the current bucket and a
+ * running sum, so adding a sample is O(1) (amortized over the buckets that
+ * expire as time moves on). Reading the window's min/max scans the
+ * buckets, and is only done when the statistics are displayed.
+ ***************************************************************************/
+
+#ifndef _TEMPD_STATS_H_
+#define _TEMPD_STATS_H_
+
+#include <stdbool.h>
+
+#define STATS_BUCKETS   60
+
+// the windows kept for every sensor
+enum statswindow {
+    STATS_1MIN = 0,
+    STATS_15MIN = 1,
+    STATS_24HOUR = 2,
+    STATS_N_WINDOWS = 3
+};
+
+struct stats_bucket {
+    int min;
+    int max;
+    long long int sum;
+    int count;
+};
+
+struct stats_window {
+    long long int width;        // msec per bucket
+    long long int epoch;        // bucket number (time / width) of cur
+    int cur;                    // current bucket
+    long long int sum;          // sum of all samples in the window
+    int count;                  // number of samples in the window
+    struct stats_bucket buckets[STATS_BUCKETS];
+};
+
+struct stats_result {
+    int min;
+    int max;
+    int avg;
+    int count;
+};
+
+void stats_window_init(struct stats_window *, long long int span_msec);
+void stats_window_add(struct stats_window *, long long int now, int value);
+bool stats_window_get(struct stats_window *, long long int now,
+                      struct stats_result *);
+
+const char *stats_window_name(enum statswindow);
+long long int stats_window_span(enum statswindow);
+
+#endif /* _TEMPD_STATS_H_ */
@@ -30,6 +30,13 @@
 
 #define TEMP_STR "Temperature sensor information\n"
 #define TEMP_DETAIL_STR "Detailed temperature sensor information\n"
+#define TEMP_COMPACT_STR "Compact, comma separated output\n"
+#define TEMP_SUBSYSTEM_STR "Show sensors in a subsystem\n"
+#define TEMP_SENSOR_STR "Show sensors matching a name (wildcards allowed)\n"
+#define TEMP_STATUS_STR "Show sensors with a status\n"
+#define TEMP_FILTER_VALUE_STR "Subsystem name, sensor name or status\n"
+#define TEMP_WATCH_STR "Continuously display changes\n"
+#define TEMP_WATCH_INTERVAL_STR "Seconds between refreshes\n"
 
 void cli_pri_init(void);
 void cli_post_init(void);
@@ -17,6 +17,10 @@
 # Software Foundation, Inc., 59 Temple Place - Suite 330, BoTeston, MA
 # 02111-1307, USA.
 
+from base64 import b64encode
+from json import loads
+from time import sleep
+
 
 TOPOLOGY = """
 # +-------+
@@ -28,6 +32,37 @@ TOPOLOGY = """
 """
 
 
+# an events socket client (for change_events): it skips the initial
+# state, then keeps 20 seconds of events
+EVENTS_CLIENT = """
+import socket
+import time
+
+s = socket.socket(socket.AF_UNIX)
+s.connect('/var/run/openvswitch/ops-tempd.events')
+s.sendall(b'deadband 2000\\nfilter base-1\\n')
+s.settimeout(1)
+
+
+def read(seconds):
+    data = b''
+    end = time.time() + seconds
+    while time.time() < end:
+        try:
+            chunk = s.recv(4096)
+        except socket.timeout:
+            continue
+        if not chunk:
+            break
+        data += chunk
+    return data
+
+read(3)
+open('/tmp/events.ready', 'w').close()
+open('/tmp/events.tmp', 'wb').write(read(20))
+"""
+
+
 def init_temp_sensor_table(sw1):
     output = sw1('list subsystem', shell='vsctl')
     lines = output.split('\n')
@@ -59,6 +94,560 @@ def show_system_temperature(sw1, step):
     assert counter is 3
 
 
+def show_system_temperature_filter(sw1, step):
+    step('Test to verify \'show system temperature\' filters')
+    output = sw1('show system temperature sensor base-1')
+    assert 'base-1' in output
+    output = sw1('show system temperature sensor base-*')
+    assert 'base-1' in output
+    output = sw1('show system temperature status normal')
+    assert 'base-1' in output
+    output = sw1('show system temperature status critical')
+    assert 'base-1' not in output
+
+
+def show_system_temperature_compact(sw1, step):
+    step('Test to verify \'show system temperature compact\' command')
+    output = sw1('show system temperature compact sensor base-1')
+    lines = [line.strip() for line in output.split('\n')
+             if line.startswith('base-1,')]
+    assert len(lines) == 1
+    fields = lines[0].split(',')
+    assert fields[2] == '20500'
+    assert fields[5] == 'normal'
+
+
+def show_system_temperature_watch(sw1, step):
+    step('Test to verify \'show system temperature watch\' redraws a '
+         'changed row')
+    # change the sensor while the watch runs, then press Enter
+    output = sw1('(sleep 2; '
+                 'ovs-vsctl set Temp_sensor $(ovs-vsctl --bare '
+                 '--columns=_uuid find Temp_sensor name=base-1) '
+                 'temperature=33330 status=max >/dev/null; '
+                 'sleep 3; echo) | '
+                 'vtysh -c "show system temperature watch 1"',
+                 shell='bash')
+    # the first draw is plain, the changed row is redrawn highlighted
+    assert '\033[7mbase-1' in output
+    redrawn = output.split('\033[7mbase-1', 1)[1].split('\n')[0]
+    assert '33.33' in redrawn
+    assert 'max' in redrawn
+
+
+def cached_dump(sw1, step):
+    step('Test to verify that cached dumps follow state changes')
+    try:
+        for temp in (45000, 46000):
+            sw1('ovs-appctl -t ops-tempd ops-tempd/test base-1 {}'.format(
+                temp), shell='bash')
+            sleep(6)
+            output = sw1('ovs-appctl -t ops-tempd ops-tempd/dump-json '
+                         'base-1 temperature', shell='bash')
+            assert '"temperature":{}'.format(temp) in output
+            output = sw1('ovs-appctl -t ops-tempd ops-tempd/dump',
+                         shell='bash')
+            sensor = output.split('Sensor name: base-1\n')[1]
+            assert 'Temperature: {}\n'.format(temp // 1000) in sensor
+    finally:
+        sw1('ovs-appctl -t ops-tempd ops-tempd/test base-1 -1',
+            shell='bash')
+
+
+def sensor_state(sw1, name):
+    # a sensor's restorable state, from ops-tempd/dump-json
+    output = sw1('ovs-appctl -t ops-tempd ops-tempd/dump-json {} '
+                 'status,min,max'.format(name), shell='bash')
+    sensor = loads(output.strip())['sensors'][0]
+    return sensor['status'], sensor['min'], sensor['max']
+
+
+def warm_restart(sw1, step):
+    step('Test to verify that a restarted ops-tempd restores its state')
+    state_file = '/var/run/openvswitch/ops-tempd.state'
+    # a max that only this run has seen
+    sw1('ovs-appctl -t ops-tempd ops-tempd/test base-1 70000', shell='bash')
+    sleep(6)
+    sw1('ovs-appctl -t ops-tempd ops-tempd/test base-1 -1', shell='bash')
+    sleep(6)
+    before = sensor_state(sw1, 'base-1')
+    assert before[2] == 70000
+
+    sw1('systemctl restart ops-tempd', shell='bash')
+    sleep(5)
+    assert sensor_state(sw1, 'base-1') == before
+
+    # a state file from another version is discarded (and rewritten)
+    try:
+        sw1('systemctl stop ops-tempd && '
+            'printf "\\x63\\x00\\x00\\x00" | dd of={} bs=1 seek=4 '
+            'conv=notrunc 2>/dev/null'.format(state_file), shell='bash')
+    finally:
+        sw1('systemctl start ops-tempd', shell='bash')
+    sleep(5)
+    assert sensor_state(sw1, 'base-1')[2] < 70000
+    output = sw1('od -An -tu4 -j4 -N4 {}'.format(state_file), shell='bash')
+    assert output.strip() == '2'
+
+
+def replay_fan_duty(sw1, step):
+    step('Test to verify the fan duty request against a replayed trace')
+    sw1('rm -rf /tmp/duty && mkdir -p /tmp/duty/trace && '
+        'cp -r {}/. /tmp/duty/hw'.format(get_hw_desc_dir(sw1)), shell='bash')
+    sw1('echo \'{"sensors": {"1": {"fan_duty": {"mode": "curve", '
+        '"points": [[35, 20], [45, 50], [60, 100]]}}}}\' '
+        '> /tmp/duty/hw/tempd.json', shell='bash')
+    # 30 C to 70 C and back, in 1 C steps every 10 seconds
+    sw1('for i in $(seq 0 80); do t=$((i <= 40 ? 30 + i : 110 - i)); '
+        'echo "$((i * 10)),$t"; done > /tmp/duty/trace/base-1.csv',
+        shell='bash')
+    output = sw1('ops-tempd --replay=/tmp/duty/trace '
+                 '--hw-desc-dir=/tmp/duty/hw --flight-recorder=none',
+                 shell='bash')
+    duties = [int(line.split(',')[4]) for line in output.split('\n')
+              if line.startswith(tuple('0123456789')) and
+              line.split(',')[1:3] == ['base-1', 'duty']]
+    assert duties[0] == 20
+    assert max(duties) == 100
+    assert duties[-1] == 20
+    peak = duties.index(100)
+    assert duties[:peak + 1] == sorted(duties[:peak + 1])
+    assert duties[peak:] == sorted(duties[peak:], reverse=True)
+    assert all(0 <= duty <= 100 for duty in duties)
+
+
+def replay_pi_duty(sw1, step):
+    step('Test to verify the PI fan duty request against replayed traces')
+    sw1('rm -rf /tmp/duty && mkdir -p /tmp/duty/trace && '
+        'cp -r {}/. /tmp/duty/hw'.format(get_hw_desc_dir(sw1)), shell='bash')
+    sw1('echo \'{"sensors": {"1": {"fan_duty": {"mode": "pi", '
+        '"setpoint": 50, "kp": 8, "ki": 0.05}}}}\' '
+        '> /tmp/duty/hw/tempd.json', shell='bash')
+
+    def replay(trace):
+        sw1('printf "{}" > /tmp/duty/trace/base-1.csv'.format(
+            ''.join('{},{}\\n'.format(t, c) for t, c in trace)),
+            shell='bash')
+        output = sw1('ops-tempd --replay=/tmp/duty/trace '
+                     '--hw-desc-dir=/tmp/duty/hw --flight-recorder=none',
+                     shell='bash')
+        return [(float(line.split(',')[0]), int(line.split(',')[4]))
+                for line in output.split('\n')
+                if line.startswith(tuple('0123456789')) and
+                line.split(',')[1:3] == ['base-1', 'duty']]
+
+    # below the setpoint, then above it until the output saturates, then
+    # back at the setpoint: the integral hasn't wound up while saturated
+    duties = replay([(t, 40 if t < 100 else 60 if t < 200 else 50)
+                     for t in range(0, 400, 5)])
+    assert duties[0][1] == 0
+    hot = [duty for t, duty in duties if 100 <= t < 200]
+    assert hot == sorted(hot)
+    assert hot[-1] == 100
+    assert duties[-1][1] < 50
+
+    # a held value leaves the request alone, a failed sensor asks for
+    # the maximum, and a recovered one goes back to the loop
+    duties = replay([(t, 'fault' if 100 <= t < 120 else 52 if t < 100
+                      else 40) for t in range(0, 300, 5)])
+    before = [duty for t, duty in duties if t < 100][-1]
+    assert before < 100
+    assert not [duty for t, duty in duties if t == 100]
+    assert [duty for t, duty in duties if 100 < t < 120] == [100]
+    assert duties[-1][1] == 0
+    sw1('rm -rf /tmp/duty', shell='bash')
+
+
+def replay_lm75_decode(sw1, step):
+    step('Test to verify the lm75 register decode at 9 and 12 bits')
+    sw1('rm -rf /tmp/lm75 && mkdir -p /tmp/lm75/trace && '
+        'cp -r {}/. /tmp/lm75/hw'.format(get_hw_desc_dir(sw1)), shell='bash')
+    # big jumps, so the plausibility checks are turned off (max_rate 0)
+    sw1('printf "0,-10.3\\n10,-0.1\\n20,25.3\\n30,-0.1\\n" '
+        '> /tmp/lm75/trace/base-1.csv', shell='bash')
+
+    def replay(settings):
+        sw1('echo \'{{"sensors": {{"1": {}}}}}\' > '
+            '/tmp/lm75/hw/tempd.json'.format(settings), shell='bash')
+        output = sw1('ops-tempd --replay=/tmp/lm75/trace '
+                     '--hw-desc-dir=/tmp/lm75/hw --flight-recorder=none',
+                     shell='bash')
+        return [int(line.split(',')[4]) for line in output.split('\n')
+                if line.startswith(tuple('0123456789')) and
+                line.split(',')[1:3] == ['base-1', 'db']]
+
+    # a plain lm75 has 0.5 C steps, a 12-bit tmp75 1/16 C steps; both
+    # round down, negative values included
+    assert replay('{"max_rate": 0}') == [-10500, -500, 25000, -500]
+    assert replay('{"variant": "tmp75", "resolution": 12, '
+                  '"max_rate": 0}') == [-10312, -125, 25250, -125]
+    sw1('rm -rf /tmp/lm75', shell='bash')
+
+
+def replay_flight_recorder(sw1, step):
+    step('Test to verify that a recorded replay decodes to its trace')
+    sw1('rm -rf /tmp/rec && mkdir -p /tmp/rec/trace && '
+        'cp -r {}/. /tmp/rec/hw'.format(get_hw_desc_dir(sw1)), shell='bash')
+    sw1('echo \'{}\' > /tmp/rec/hw/tempd.json', shell='bash')
+    sw1('printf "0,30\\n10,31.5\\n20,fault\\n30,32\\n" '
+        '> /tmp/rec/trace/base-1.csv', shell='bash')
+    sw1('ops-tempd --replay=/tmp/rec/trace --hw-desc-dir=/tmp/rec/hw '
+        '--flight-recorder=/tmp/rec/base.rec', shell='bash')
+    output = sw1('ops-tempd-recdump /tmp/rec/base.rec', shell='bash')
+    lines = [line.strip() for line in output.split('\n')]
+    assert '# seconds,sensor,event,value' in lines
+    assert not [line for line in lines if 'truncated' in line]
+    readings = [tuple(line.split(',')[i] for i in (0, 2, 3))
+                for line in lines if line.split(',')[1:2] == ['base-1'] and
+                line.split(',')[2] in ('temp', 'fault')]
+    # one reading per 5 second poll
+    assert readings == [('0.000', 'temp', '30.000'),
+                        ('5.000', 'temp', '30.000'),
+                        ('10.000', 'temp', '31.500'),
+                        ('15.000', 'temp', '31.500'),
+                        ('20.000', 'fault', ''),
+                        ('25.000', 'fault', ''),
+                        ('30.000', 'temp', '32.000')]
+    assert [line for line in lines
+            if line.startswith('0.000,base-1,state,')]
+    sw1('rm -rf /tmp/rec', shell='bash')
+
+
+def replay_stats(sw1, step):
+    step('Test to verify the rolling statistics windows against a replay')
+    sw1('rm -rf /tmp/stats && mkdir -p /tmp/stats/trace && '
+        'cp -r {}/. /tmp/stats/hw'.format(get_hw_desc_dir(sw1)), shell='bash')
+    sw1('echo \'{}\' > /tmp/stats/hw/tempd.json', shell='bash')
+    # 40 C for 5 minutes, then 30 C for 5 minutes: one sample per poll
+    sw1('for t in $(seq 0 5 600); do echo "$t,$((t < 300 ? 40 : 30))"; '
+        'done > /tmp/stats/trace/base-1.csv', shell='bash')
+    output = sw1('ops-tempd --replay=/tmp/stats/trace '
+                 '--hw-desc-dir=/tmp/stats/hw --flight-recorder=none',
+                 shell='bash')
+    line = [line for line in output.split('\n')
+            if line.startswith('# dump-json ')][0]
+    sensors = loads(line[len('# dump-json '):])['sensors']
+    stats = [sensor['stats'] for sensor in sensors
+             if sensor['name'] == 'base-1'][0]
+    # the last minute only has 30 C, the longer windows have everything
+    assert stats['1m'] == {'min': 30000, 'avg': 30000, 'max': 30000,
+                           'samples': 12}
+    everything = {'min': 30000, 'avg': (60 * 40000 + 61 * 30000) // 121,
+                  'max': 40000, 'samples': 121}
+    assert stats['15m'] == everything
+    assert stats['24h'] == everything
+    sw1('rm -rf /tmp/stats', shell='bash')
+
+
+def replay_transition_log(sw1, step):
+    step('Test to verify the transition log rate limit against a replay')
+    sw1('rm -rf /tmp/flap && mkdir -p /tmp/flap/trace && '
+        'cp -r {}/. /tmp/flap/hw'.format(get_hw_desc_dir(sw1)), shell='bash')
+    # a composite of sensor 1 with thresholds of its own: max from 50 C,
+    # back to normal at 45 C, nothing else in reach
+    sw1('echo \'{"sensors": {"1": {"max_rate": 0}}, "composites": '
+        '{"100": {"op": "max", "inputs": [1], "alarm_thresholds": '
+        '{"emergency_on": 200, "emergency_off": 190, "critical_on": 150, '
+        '"critical_off": 140, "max_on": 50, "max_off": 45, "min": -50, '
+        '"low_crit": -60}, "fan_thresholds": {"max_on": 190, '
+        '"max_off": 180, "fast_on": 185, "fast_off": 175, '
+        '"medium_on": 180, "medium_off": 170}}}}\' '
+        '> /tmp/flap/hw/tempd.json', shell='bash')
+    # 30 C, then flapping between 60 C and 30 C on every poll for three
+    # minutes: a transition on each of the 35 polls after the first
+    sw1('for i in $(seq 0 35); do echo "$((i * 5)),$((i % 2 ? 60 : 30))"; '
+        'done > /tmp/flap/trace/base-1.csv', shell='bash')
+    output = sw1('ops-tempd --replay=/tmp/flap/trace '
+                 '--hw-desc-dir=/tmp/flap/hw --flight-recorder=none',
+                 shell='bash')
+    line = [line for line in output.split('\n')
+            if line.startswith('# dump-json ')][0]
+    sensors = loads(line[len('# dump-json '):])['sensors']
+    transitions = [sensor['transitions'] for sensor in sensors
+                   if sensor['name'] == 'base-100'][0]
+    # 5 logged per minute: 11 transitions in the first minute, 12 in
+    # each of the next two
+    assert transitions == {'logged': 15, 'rate_limited': 20}
+    sw1('rm -rf /tmp/flap', shell='bash')
+
+
+def replay_traces(sw1, ext, traces):
+    # replay csv traces ({sensor number: [(seconds, degrees), ...]})
+    # with a tempd.json, and return the db temperatures written for each
+    # sensor and the number of implausible readings
+    sw1('rm -f /tmp/plausible/trace/* && echo \'{}\' > '
+        '/tmp/plausible/hw/tempd.json'.format(ext), shell='bash')
+    for number, trace in traces.items():
+        sw1('printf "{}" > /tmp/plausible/trace/base-{}.csv'.format(
+            ''.join('{},{}\\n'.format(t, c) for t, c in trace), number),
+            shell='bash')
+    output = sw1('ops-tempd --replay=/tmp/plausible/trace '
+                 '--hw-desc-dir=/tmp/plausible/hw --flight-recorder=none',
+                 shell='bash')
+    temps = {}
+    implausible = None
+    for line in output.split('\n'):
+        fields = line.strip().split(',')
+        if len(fields) == 5 and fields[2] == 'db':
+            temps.setdefault(fields[1], []).append(int(fields[4]))
+        if 'implausible readings' in line:
+            implausible = int(line.split('implausible readings')[1])
+    return temps, implausible
+
+
+def replay_plausibility(sw1, step):
+    step('Test to verify the plausibility checks against replayed traces')
+    hw_desc_dir = get_hw_desc_dir(sw1)
+    sw1('rm -rf /tmp/plausible && mkdir -p /tmp/plausible/trace && '
+        'cp -r {}/. /tmp/plausible/hw'.format(hw_desc_dir), shell='bash')
+
+    # two more sensors, copies of sensor 1, to make a peer group
+    yaml_path = sw1('grep -ls alarm_thresholds /tmp/plausible/hw/*.yaml',
+                    shell='bash').strip().split('\n')[0]
+    lines = sw1('cat {}'.format(yaml_path), shell='bash').split('\n')
+    lines = [line.rstrip('\r') for line in lines]
+    first = [idx for idx, line in enumerate(lines)
+             if line.strip().replace(' ', '') in ('-number:1', 'number:1')][0]
+    indent = len(lines[first]) - len(lines[first].lstrip())
+    end = first + 1
+    while end < len(lines) and (not lines[end].strip() or
+                                len(lines[end]) - len(lines[end].lstrip()) >
+                                indent):
+        end += 1
+    block = lines[first:end]
+    for number in (91, 92):
+        lines[end:end] = [block[0].replace('1', str(number))] + block[1:]
+    lines = [line.split(':')[0] + ': {}'.format(int(line.split(':')[1]) + 2)
+             if line.strip().startswith('number_sensors:') else line
+             for line in lines]
+    sw1('echo {} | base64 -d > {}'.format(
+        b64encode('\n'.join(lines).encode()).decode(), yaml_path),
+        shell='bash')
+
+    steady = [(t, 35) for t in range(0, 300, 5)]
+    glitch = [(t, 127 if t == 60 else 35) for t in range(0, 300, 5)]
+    rise = [(t, 70 if t >= 60 else 35) for t in range(0, 300, 5)]
+    hot = [(t, 60) for t in range(0, 300, 5)]
+    group = '{"peer_groups": {"g": {"sensors": [1, 91, 92], ' \
+            '"max_spread": 10}}}'
+
+    # without peers: a glitch is dropped, a real step is confirmed
+    temps, implausible = replay_traces(sw1, '{}', {1: glitch})
+    assert max(temps['base-1']) == 35000
+    assert implausible == 1
+    temps, implausible = replay_traces(sw1, '{}', {1: rise})
+    assert temps['base-1'][-1] == 70000
+    assert implausible == 2
+
+    # with peers that stay put: the same
+    temps, implausible = replay_traces(
+        sw1, group, {1: glitch, 91: steady, 92: steady})
+    assert max(temps['base-1']) == 35000
+    assert implausible == 1
+    temps, implausible = replay_traces(
+        sw1, group, {1: rise, 91: steady, 92: steady})
+    assert temps['base-1'][-1] == 70000
+    assert temps['base-91'][-1] == 35000
+
+    # a group that disagrees from the start: every sensor gets going
+    temps, implausible = replay_traces(
+        sw1, group, {1: hot, 91: steady, 92: steady})
+    assert temps['base-1'][-1] == 60000
+    assert temps['base-91'][-1] == 35000
+    assert temps['base-92'][-1] == 35000
+    sw1('rm -rf /tmp/plausible', shell='bash')
+
+
+def get_hw_desc_dir(sw1):
+    return sw1('ovs-vsctl get subsystem base hw_desc_dir',
+               shell='bash').strip().strip('"')
+
+
+def set_tempd_ext(sw1, hw_desc_dir, ext):
+    # install a tempd.json (keeping the original) and restart ops-tempd
+    sw1('[ -e /tmp/tempd.json.orig ] || '
+        'cp {0}/tempd.json /tmp/tempd.json.orig 2>/dev/null || '
+        'touch /tmp/tempd.json.none'.format(hw_desc_dir), shell='bash')
+    sw1('echo \'{}\' > {}/tempd.json && systemctl restart ops-tempd'.format(
+        ext, hw_desc_dir), shell='bash')
+    sleep(5)
+
+
+def restore_tempd_ext(sw1, hw_desc_dir):
+    sw1('if [ -e /tmp/tempd.json.none ]; then rm -f {0}/tempd.json '
+        '/tmp/tempd.json.none; else mv /tmp/tempd.json.orig {0}/tempd.json; '
+        'fi; systemctl restart ops-tempd'.format(hw_desc_dir), shell='bash')
+    sleep(5)
+
+
+def cpu_ticks(sw1, seconds):
+    # user + system clock ticks used by ops-tempd over some seconds
+    output = sw1('pid=$(pidof ops-tempd); '
+                 'a=$(awk \'{{print $14 + $15}}\' /proc/$pid/stat); '
+                 'sleep {}; '
+                 'b=$(awk \'{{print $14 + $15}}\' /proc/$pid/stat); '
+                 'echo $((b - a))'.format(seconds), shell='bash')
+    return int(output.strip())
+
+
+def hardware_alert_fifo(sw1, step):
+    step('Test to verify that a fifo alert wakes ops-tempd without spinning')
+    hw_desc_dir = get_hw_desc_dir(sw1)
+    sw1('rm -f /tmp/tempd-alert && mkfifo /tmp/tempd-alert', shell='bash')
+    set_tempd_ext(sw1, hw_desc_dir,
+                  '{"sensors": {"1": {"alert": "/tmp/tempd-alert"}}}')
+    try:
+        output = sw1('ovs-appctl -t ops-tempd ops-tempd/dump', shell='bash')
+        assert 'Hardware alert: armed' in output
+
+        # an alert, after which the writer goes away: ops-tempd must go
+        # back to sleeping rather than waking on the hangup
+        before = sw1('ovs-appctl -t ops-tempd ops-tempd/dump-json base-1 '
+                     'sample', shell='bash')
+        sw1('echo 1 > /tmp/tempd-alert', shell='bash')
+        sleep(1)
+        after = sw1('ovs-appctl -t ops-tempd ops-tempd/dump-json base-1 '
+                    'sample', shell='bash')
+        assert before != after
+        assert cpu_ticks(sw1, 3) < 30
+    finally:
+        restore_tempd_ext(sw1, hw_desc_dir)
+        sw1('rm -f /tmp/tempd-alert', shell='bash')
+
+
+def inject_emergency(sw1, step):
+    step('Test to verify that an injected emergency doesn\'t shut down')
+    hw_desc_dir = get_hw_desc_dir(sw1)
+    auto_shutdown = sw1('grep -rqs "auto_shutdown: *true" {} && echo yes '
+                        '|| echo no'.format(hw_desc_dir),
+                        shell='bash').strip() == 'yes'
+    # a composite of base-1, read after it, shows that the other sensors
+    # are still read after a simulated emergency
+    set_tempd_ext(sw1, hw_desc_dir,
+                  '{"composites": {"100": {"op": "max", "inputs": [1]}}}')
+    try:
+        output = sw1('ovs-appctl -t ops-tempd ops-tempd/inject step '
+                     'base-1 60 150', shell='bash')
+        assert 'applied to 1 sensor(s)' in output
+        sleep(12)
+        output = sw1('ovs-appctl -t ops-tempd ops-tempd/dump', shell='bash')
+        assert 'Status: emergency' in output
+        assert 'Emergency shutdown: sensor' not in output
+        if auto_shutdown:
+            assert 'Emergency shutdown: skipped' in output
+        assert sw1('pidof ops-tempd', shell='bash').strip() != ''
+        output = sw1('ovs-appctl -t ops-tempd ops-tempd/dump-json base-100 '
+                     'temperature', shell='bash')
+        assert '"temperature":150000' in output
+
+        # clear takes no profile arguments
+        output = sw1('ovs-appctl -t ops-tempd ops-tempd/inject clear base-1 '
+                     '60 2>&1', shell='bash')
+        assert 'clear takes no arguments' in output
+        output = sw1('ovs-appctl -t ops-tempd ops-tempd/dump', shell='bash')
+        assert 'Injection: step' in output
+        output = sw1('ovs-appctl -t ops-tempd ops-tempd/inject clear base-1',
+                     shell='bash')
+        assert 'clear applied to 1 sensor(s)' in output
+        output = sw1('ovs-appctl -t ops-tempd ops-tempd/dump', shell='bash')
+        assert 'Injection:' not in output
+    finally:
+        restore_tempd_ext(sw1, hw_desc_dir)
+
+
+def change_events(sw1, step):
+    step('Test to verify the change events with a deadband and a filter')
+    hw_desc_dir = get_hw_desc_dir(sw1)
+    # base-100 follows base-1, and is filtered out
+    set_tempd_ext(sw1, hw_desc_dir,
+                  '{"composites": {"100": {"op": "min", "inputs": [1]}}}')
+    try:
+        sw1('ovs-appctl -t ops-tempd ops-tempd/test base-1 30000',
+            shell='bash')
+        sleep(6)
+        sw1('rm -f /tmp/events.*; echo {} | base64 -d > /tmp/events.py; '
+            '(python /tmp/events.py && mv /tmp/events.tmp /tmp/events.out) '
+            '>/dev/null 2>&1 &'.format(
+                b64encode(EVENTS_CLIENT.encode()).decode()), shell='bash')
+        sw1('for i in $(seq 10); do [ -e /tmp/events.ready ] && break; '
+            'sleep 1; done', shell='bash')
+        # below the deadband, then above it
+        sw1('ovs-appctl -t ops-tempd ops-tempd/test base-1 31000',
+            shell='bash')
+        sleep(6)
+        sw1('ovs-appctl -t ops-tempd ops-tempd/test base-1 40000',
+            shell='bash')
+        sleep(6)
+        output = sw1('ovs-appctl -t ops-tempd ops-tempd/dump', shell='bash')
+        assert 'Change events:' in output
+        assert '(1 subscriber(s)' in output
+        output = sw1('for i in $(seq 20); do [ -e /tmp/events.out ] && '
+                     'break; sleep 1; done; cat /tmp/events.out',
+                     shell='bash')
+        events = [line for line in output.split('\n')
+                  if line.startswith('{"sensor":')]
+        assert len(events) == 1
+        assert events[0].startswith('{"sensor":"base-1",')
+        assert events[0].endswith('"temperature":40000}')
+    finally:
+        sw1('ovs-appctl -t ops-tempd ops-tempd/test base-1 -1; '
+            'rm -f /tmp/events.*', shell='bash')
+        restore_tempd_ext(sw1, hw_desc_dir)
+
+
+def stubbed_emergency_shutdown(sw1, step):
+    step('Test to verify the emergency shutdown stages with a stub')
+    hw_desc_dir = get_hw_desc_dir(sw1)
+    # a copy of the hardware description with emergency shutdown on
+    sw1('rm -rf /tmp/shutdown && mkdir -p /tmp/shutdown && '
+        'cp -r {}/. /tmp/shutdown/hw && '
+        'sed -i "s/auto_shutdown: *false/auto_shutdown: true/" '
+        '/tmp/shutdown/hw/*.yaml'.format(hw_desc_dir), shell='bash')
+    output = sw1('grep -qs "auto_shutdown: *true" /tmp/shutdown/hw/*.yaml '
+                 '&& echo yes || echo no', shell='bash')
+    if output.strip() != 'yes':
+        step('No emergency shutdown setting to turn on, skipping')
+        return
+    sw1('printf \'#!/bin/sh\\necho "$@" > /tmp/shutdown/args\\n\' '
+        '> /tmp/shutdown/poweroff && chmod +x /tmp/shutdown/poweroff',
+        shell='bash')
+
+    # run ops-tempd with the stub, from the copy
+    sw1('systemctl stop ops-tempd && '
+        'ovs-vsctl set subsystem base hw_desc_dir=/tmp/shutdown/hw && '
+        'ops-tempd --detach --pidfile '
+        '--emergency-action=/tmp/shutdown/poweroff --simulated-shutdown',
+        shell='bash')
+    try:
+        sleep(5)
+        sw1('ovs-appctl -t ops-tempd ops-tempd/inject step base-1 60 150',
+            shell='bash')
+        # a poll, then the stages: the poweroff stage waits 10 seconds for
+        # the power to go
+        sleep(20)
+        output = sw1('ovs-appctl -t ops-tempd ops-tempd/dump', shell='bash')
+        assert 'Emergency shutdown: sensor base-1' in output
+        stages = dict(line.strip().split(': ', 1)
+                      for line in output.split('\n')
+                      if line.startswith('\t') and
+                      not line.startswith('\t\t') and
+                      line.strip().split(':')[0] in
+                      ('record', 'notify', 'poweroff', 'escalate'))
+        assert stages['record'].endswith('(ok)')
+        assert 'notify' in stages
+        # the stub exits, and the power doesn't go
+        assert stages['poweroff'].endswith('(Connection timed out)')
+        assert stages['escalate'].endswith('(ok)')
+        args = sw1('cat /tmp/shutdown/args', shell='bash')
+        assert '--poweroff --force --no-wtmp' in args
+    finally:
+        sw1('ovs-appctl -t ops-tempd exit; '
+            'ovs-vsctl set subsystem base hw_desc_dir={} && '
+            'systemctl start ops-tempd'.format(hw_desc_dir), shell='bash')
+        sleep(5)
+        sw1('rm -rf /tmp/shutdown', shell='bash')
+
+
 def test_tempd_ct_tempsensor(topology, step):
     sw1 = topology.get("sw1")
     assert sw1 is not None
@@ -66,3 +655,19 @@ def test_tempd_ct_tempsensor(topology, step):
     init_temp_sensor_table(sw1)
     step('Test to verify \'show system temperature\' command')
     show_system_temperature(sw1, step)
+    show_system_temperature_filter(sw1, step)
+    show_system_temperature_compact(sw1, step)
+    show_system_temperature_watch(sw1, step)
+    cached_dump(sw1, step)
+    warm_restart(sw1, step)
+    replay_fan_duty(sw1, step)
+    replay_pi_duty(sw1, step)
+    replay_lm75_decode(sw1, step)
+    replay_flight_recorder(sw1, step)
+    replay_stats(sw1, step)
+    replay_transition_log(sw1, step)
+    replay_plausibility(sw1, step)
+    hardware_alert_fifo(sw1, step)
+    inject_emergency(sw1, step)
+    change_events(sw1, step)
+    stubbed_emergency_shutdown(sw1, step)
@@ -24,68 +24,327 @@
  */
 
 #include <sys/wait.h>
+#include <ctype.h>
+#include <fnmatch.h>
+#include <inttypes.h>
+#include <stdlib.h>
+#include <string.h>
+#include <poll.h>
+#include <unistd.h>
 #include "vtysh/command.h"
 #include "memory.h"
 #include "vtysh/vtysh.h"
 #include "vtysh/vtysh_user.h"
+#include "vtysh/vtysh_ovsdb_if.h"
 #include "vswitch-idl.h"
 #include "ovsdb-idl.h"
 #include "temperature_vty.h"
 #include "smap.h"
+#include "shash.h"
+#include "util.h"
 #include "openvswitch/vlog.h"
 #include "openswitch-idl.h"
 
 VLOG_DEFINE_THIS_MODULE(vtysh_temperature_cli);
 extern struct ovsdb_idl *idl;
 
+/* Sorted index of the Temp_sensor table, rebuilt once per IDL seqno. */
+struct temp_index_entry {
+    const struct ovsrec_temp_sensor *row;
+    const char *subsystem;      /* Name of the containing subsystem. */
+};
+
+static struct temp_index_entry *temp_index;
+static size_t temp_index_n;
+static size_t temp_index_allocated;
+static unsigned int temp_index_seqno;
+static bool temp_index_valid = false;
+
+/* Filters for the show commands. */
+enum temp_filter {
+    TEMP_FILTER_NONE,
+    TEMP_FILTER_SUBSYSTEM,
+    TEMP_FILTER_SENSOR,
+    TEMP_FILTER_STATUS
+};
+
 /*
- * Function     : vtysh_ovsdb_show_temp_sensor
- * Responsibility : display temperature sensor information
- * Parameters
- *    detail   : boolean param to decide whether detailed description or brief
- description
+ * Function       : natural_strcmp
+ * Responsibility : compare strings, treating runs of digits as numbers,
+ *                  so that "base-2" sorts before "base-10"
  */
-
-static void
-vtysh_ovsdb_show_temp_sensor (boolean detail)
+static int
+natural_strcmp (const char *a, const char *b)
 {
-    const struct ovsrec_temp_sensor *row;
-    OVSREC_TEMP_SENSOR_FOR_EACH (row, idl)
+    while (*a && *b)
     {
-        if (row)
+        if (isdigit((unsigned char)*a) && isdigit((unsigned char)*b))
         {
-            if (!detail)
+            size_t len_a, len_b;
+            int rc;
+
+            while (*a == '0') a++;
+            while (*b == '0') b++;
+            for (len_a = 0; isdigit((unsigned char)a[len_a]); len_a++);
+            for (len_b = 0; isdigit((unsigned char)b[len_b]); len_b++);
+            if (len_a != len_b)
             {
-                vty_out (vty,"%-10s%-15.2f%-15s%-10s%s",
-                        row->name,((row->temperature)/1000.0),
-                        row->status, row->fan_state,VTY_NEWLINE);
+                return len_a < len_b ? -1 : 1;
             }
-            else
+            rc = strncmp(a, b, len_a);
+            if (rc)
             {
-                vty_out(vty,"%-26s:%s %s","Name",row->name,VTY_NEWLINE);
-                vty_out(vty,"%-26s:%s %s","Location",row->location,
-                        VTY_NEWLINE);
-                vty_out(vty,"%-26s:%s %s","Status",row->status,VTY_NEWLINE);
-                vty_out(vty,"%-26s:%s %s",
-                        "Fan-state",row->fan_state,VTY_NEWLINE);
-                vty_out(vty,"%-26s:%.2f%s",
-                        "Current temperature(in C)",
-                        ((row->temperature)/1000.0),VTY_NEWLINE);
-                vty_out(vty,"%-26s:%.2f%s",
-                        "Minimum temperature(in C)",
-                        ((row->min)/1000.0),VTY_NEWLINE);
-                vty_out(vty,"%-26s:%.2f%s",
-                        "Maximum temperature(in C)",
-                        ((row->max)/1000.0),VTY_NEWLINE);
-                vty_out(vty,"%s",VTY_NEWLINE);
+                return rc;
             }
+            a += len_a;
+            b += len_b;
         }
         else
         {
-            VLOG_ERR("Unable to retrieve Temp_sensor table rows");
+            if (*a != *b)
+            {
+                return (unsigned char)*a < (unsigned char)*b ? -1 : 1;
+            }
+            a++;
+            b++;
+        }
+    }
+    return (unsigned char)*a - (unsigned char)*b;
+}
+
+static int
+temp_index_cmp (const void *a_, const void *b_)
+{
+    const struct temp_index_entry *a = a_;
+    const struct temp_index_entry *b = b_;
+
+    return natural_strcmp(a->row->name, b->row->name);
+}
+
+/*
+ * Function       : temp_index_refresh
+ * Responsibility : rebuild the sorted sensor index if the IDL has changed
+ *                  since it was last built
+ */
+static void
+temp_index_refresh (void)
+{
+    const struct ovsrec_temp_sensor *row;
+    const struct ovsrec_subsystem *subsys;
+    struct shash owners = SHASH_INITIALIZER(&owners);
+    unsigned int seqno = ovsdb_idl_get_seqno(idl);
+    size_t i;
+
+    if (temp_index_valid && seqno == temp_index_seqno)
+    {
+        return;
+    }
+
+    /* Map each sensor to its subsystem. */
+    OVSREC_SUBSYSTEM_FOR_EACH (subsys, idl)
+    {
+        for (i = 0; i < subsys->n_temp_sensors; i++)
+        {
+            shash_add_once(&owners, subsys->temp_sensors[i]->name,
+                           subsys->name);
+        }
+    }
+
+    temp_index_n = 0;
+    OVSREC_TEMP_SENSOR_FOR_EACH (row, idl)
+    {
+        const char *owner = shash_find_data(&owners, row->name);
+
+        if (temp_index_n >= temp_index_allocated)
+        {
+            temp_index_allocated = temp_index_allocated ?
+                                   temp_index_allocated * 2 : 64;
+            temp_index = xrealloc(temp_index, temp_index_allocated *
+                                  sizeof *temp_index);
+        }
+        temp_index[temp_index_n].row = row;
+        temp_index[temp_index_n].subsystem = owner ? owner : "";
+        temp_index_n++;
+    }
+    shash_destroy(&owners);
+
+    qsort(temp_index, temp_index_n, sizeof *temp_index, temp_index_cmp);
+    temp_index_seqno = seqno;
+    temp_index_valid = true;
+}
+
+/*
+ * Function       : temp_filter_match
+ * Responsibility : check a sensor against the requested filter
+ */
+static bool
+temp_filter_match (const struct temp_index_entry *entry,
+                   enum temp_filter filter, const char *value)
+{
+    switch (filter)
+    {
+    case TEMP_FILTER_SUBSYSTEM:
+        return !strcmp(entry->subsystem, value);
+    case TEMP_FILTER_SENSOR:
+        return !fnmatch(value, entry->row->name, 0);
+    case TEMP_FILTER_STATUS:
+        return entry->row->status && !strcmp(entry->row->status, value);
+    case TEMP_FILTER_NONE:
+    default:
+        return true;
+    }
+}
+
+static enum temp_filter
+temp_filter_from_string (const char *name)
+{
+    if (!strcmp(name, "subsystem"))
+    {
+        return TEMP_FILTER_SUBSYSTEM;
+    }
+    else if (!strcmp(name, "sensor"))
+    {
+        return TEMP_FILTER_SENSOR;
+    }
+    else if (!strcmp(name, "status"))
+    {
+        return TEMP_FILTER_STATUS;
+    }
+    return TEMP_FILTER_NONE;
+}
+
+/* Output formats for the show commands. */
+enum temp_format {
+    TEMP_FORMAT_BRIEF,
+    TEMP_FORMAT_DETAIL,
+    TEMP_FORMAT_COMPACT
+};
+
+/*
+ * Function       : vtysh_show_temp_sensor_stats
+ * Responsibility : display the rolling statistics published by ops-tempd
+ *                  (only present when it runs with --publish-stats)
+ */
+static void
+vtysh_show_temp_sensor_stats (const struct ovsrec_temp_sensor *row)
+{
+    static const char *windows[] = { "1m", "15m", "24h" };
+    size_t i;
+
+    for (i = 0; i < sizeof windows / sizeof windows[0]; i++)
+    {
+        char key[16];
+        char label[32];
+        const char *value;
+        int min, avg, max;
+
+        snprintf(key, sizeof key, "stats_%s", windows[i]);
+        value = smap_get(&row->external_ids, key);
+        if (value && sscanf(value, "%d,%d,%d", &min, &avg, &max) == 3)
+        {
+            snprintf(label, sizeof label, "Min/avg/max %s(in C)",
+                     windows[i]);
+            vty_out(vty,"%-26s:%.2f/%.2f/%.2f%s", label, min/1000.0,
+                    avg/1000.0, max/1000.0, VTY_NEWLINE);
+        }
+    }
+}
+
+static void
+vtysh_show_temp_sensor_row (const struct temp_index_entry *entry,
+                            enum temp_format format)
+{
+    const struct ovsrec_temp_sensor *row = entry->row;
+
+    switch (format)
+    {
+    case TEMP_FORMAT_BRIEF:
+        vty_out (vty,"%-10s%-15.2f%-15s%-10s%s",
+                row->name,((row->temperature)/1000.0),
+                row->status, row->fan_state,VTY_NEWLINE);
+        break;
+    case TEMP_FORMAT_DETAIL:
+        vty_out(vty,"%-26s:%s %s","Name",row->name,VTY_NEWLINE);
+        vty_out(vty,"%-26s:%s %s","Location",row->location,
+                VTY_NEWLINE);
+        vty_out(vty,"%-26s:%s %s","Status",row->status,VTY_NEWLINE);
+        vty_out(vty,"%-26s:%s %s",
+                "Fan-state",row->fan_state,VTY_NEWLINE);
+        vty_out(vty,"%-26s:%.2f%s",
+                "Current temperature(in C)",
+                ((row->temperature)/1000.0),VTY_NEWLINE);
+        vty_out(vty,"%-26s:%.2f%s",
+                "Minimum temperature(in C)",
+                ((row->min)/1000.0),VTY_NEWLINE);
+        vty_out(vty,"%-26s:%.2f%s",
+                "Maximum temperature(in C)",
+                ((row->max)/1000.0),VTY_NEWLINE);
+        vtysh_show_temp_sensor_stats(row);
+        vty_out(vty,"%s",VTY_NEWLINE);
+        break;
+    case TEMP_FORMAT_COMPACT:
+        /* One sensor per line, temperatures in milidegrees C. */
+        vty_out(vty,"%s,%s,%"PRId64",%"PRId64",%"PRId64",%s,%s%s",
+                row->name, entry->subsystem, row->temperature,
+                row->min, row->max, row->status, row->fan_state,
+                VTY_NEWLINE);
+        break;
+    }
+}
+
+/*
+ * Function     : vtysh_ovsdb_show_temp_sensor
+ * Responsibility : display temperature sensor information, sorted by name
+ * Parameters
+ *    format   : brief, detailed or compact (machine-readable) output
+ *    filter   : which sensors to display
+ *    value    : value for the filter
+ */
+
+static void
+vtysh_ovsdb_show_temp_sensor (enum temp_format format,
+                              enum temp_filter filter, const char *value)
+{
+    size_t i;
+
+    temp_index_refresh();
+    for (i = 0; i < temp_index_n; i++)
+    {
+        if (temp_filter_match(&temp_index[i], filter, value))
+        {
+            vtysh_show_temp_sensor_row(&temp_index[i], format);
         }
     }
 }
+
+static void
+vtysh_show_temp_header (enum temp_format format)
+{
+    switch (format)
+    {
+    case TEMP_FORMAT_BRIEF:
+        vty_out(vty,"%s%s","Temperature information",VTY_NEWLINE);
+        vty_out(vty,"---------------------------------------------------%s",
+                VTY_NEWLINE);
+        vty_out(vty,"%-12s%-9s%s"," ","Current",VTY_NEWLINE);
+        vty_out(vty,"%-10s%-15s%-15s%-10s%s","Name","temperature",
+                "Status","Fan state",VTY_NEWLINE);
+        vty_out(vty,"%-12s%-6s%s"," ","(in C)",VTY_NEWLINE);
+        vty_out(vty,"---------------------------------------------------%s",
+                VTY_NEWLINE);
+        break;
+    case TEMP_FORMAT_DETAIL:
+        vty_out(vty,"%s%s","Detailed temperature information",VTY_NEWLINE);
+        vty_out(vty,"---------------------------------------------------%s",
+                VTY_NEWLINE);
+        break;
+    case TEMP_FORMAT_COMPACT:
+        vty_out(vty,"name,subsystem,temperature,min,max,status,fan_state%s",
+                VTY_NEWLINE);
+        break;
+    }
+}
+
 DEFUN (vtysh_show_system_temperature_detail,
         vtysh_show_system_temperature_detail_cmd,
         "show system temperature detail",
@@ -94,10 +353,8 @@ DEFUN (vtysh_show_system_temperature_detail,
         TEMP_STR
         TEMP_DETAIL_STR)
 {
-    vty_out(vty,"%s%s","Detailed temperature information",VTY_NEWLINE);
-    vty_out(vty,"---------------------------------------------------%s",
-            VTY_NEWLINE);
-    vtysh_ovsdb_show_temp_sensor (true);
+    vtysh_show_temp_header (TEMP_FORMAT_DETAIL);
+    vtysh_ovsdb_show_temp_sensor (TEMP_FORMAT_DETAIL, TEMP_FILTER_NONE, NULL);
     return CMD_SUCCESS;
 }
 
@@ -108,16 +365,299 @@ DEFUN (vtysh_show_system_temperature,
         SYS_STR
         TEMP_STR)
 {
-    vty_out(vty,"%s%s","Temperature information",VTY_NEWLINE);
-    vty_out(vty,"---------------------------------------------------%s",
-            VTY_NEWLINE);
-    vty_out(vty,"%-12s%-9s%s"," ","Current",VTY_NEWLINE);
-    vty_out(vty,"%-10s%-15s%-15s%-10s%s","Name","temperature",
-            "Status","Fan state",VTY_NEWLINE);
-    vty_out(vty,"%-12s%-6s%s"," ","(in C)",VTY_NEWLINE);
-    vty_out(vty,"---------------------------------------------------%s",
-            VTY_NEWLINE);
-    vtysh_ovsdb_show_temp_sensor (false);
+    vtysh_show_temp_header (TEMP_FORMAT_BRIEF);
+    vtysh_ovsdb_show_temp_sensor (TEMP_FORMAT_BRIEF, TEMP_FILTER_NONE, NULL);
+    return CMD_SUCCESS;
+}
+
+DEFUN (vtysh_show_system_temperature_filter,
+        vtysh_show_system_temperature_filter_cmd,
+        "show system temperature (subsystem|sensor|status) WORD",
+        SHOW_STR
+        SYS_STR
+        TEMP_STR
+        TEMP_SUBSYSTEM_STR
+        TEMP_SENSOR_STR
+        TEMP_STATUS_STR
+        TEMP_FILTER_VALUE_STR)
+{
+    vtysh_show_temp_header (TEMP_FORMAT_BRIEF);
+    vtysh_ovsdb_show_temp_sensor (TEMP_FORMAT_BRIEF,
+                                  temp_filter_from_string(argv[0]), argv[1]);
+    return CMD_SUCCESS;
+}
+
+DEFUN (vtysh_show_system_temperature_detail_filter,
+        vtysh_show_system_temperature_detail_filter_cmd,
+        "show system temperature detail (subsystem|sensor|status) WORD",
+        SHOW_STR
+        SYS_STR
+        TEMP_STR
+        TEMP_DETAIL_STR
+        TEMP_SUBSYSTEM_STR
+        TEMP_SENSOR_STR
+        TEMP_STATUS_STR
+        TEMP_FILTER_VALUE_STR)
+{
+    vtysh_show_temp_header (TEMP_FORMAT_DETAIL);
+    vtysh_ovsdb_show_temp_sensor (TEMP_FORMAT_DETAIL,
+                                  temp_filter_from_string(argv[0]), argv[1]);
+    return CMD_SUCCESS;
+}
+
+DEFUN (vtysh_show_system_temperature_compact,
+        vtysh_show_system_temperature_compact_cmd,
+        "show system temperature compact",
+        SHOW_STR
+        SYS_STR
+        TEMP_STR
+        TEMP_COMPACT_STR)
+{
+    vtysh_show_temp_header (TEMP_FORMAT_COMPACT);
+    vtysh_ovsdb_show_temp_sensor (TEMP_FORMAT_COMPACT, TEMP_FILTER_NONE, NULL);
+    return CMD_SUCCESS;
+}
+
+DEFUN (vtysh_show_system_temperature_compact_filter,
+        vtysh_show_system_temperature_compact_filter_cmd,
+        "show system temperature compact (subsystem|sensor|status) WORD",
+        SHOW_STR
+        SYS_STR
+        TEMP_STR
+        TEMP_COMPACT_STR
+        TEMP_SUBSYSTEM_STR
+        TEMP_SENSOR_STR
+        TEMP_STATUS_STR
+        TEMP_FILTER_VALUE_STR)
+{
+    vtysh_show_temp_header (TEMP_FORMAT_COMPACT);
+    vtysh_ovsdb_show_temp_sensor (TEMP_FORMAT_COMPACT,
+                                  temp_filter_from_string(argv[0]), argv[1]);
+    return CMD_SUCCESS;
+}
+
+/* Terminal control sequences used by the watch command. */
+#define WATCH_CLEAR         "\033[H\033[2J"
+#define WATCH_GOTO          "\033[%zu;1H"
+#define WATCH_HIGHLIGHT     "\033[7m"
+#define WATCH_NORMAL        "\033[0m"
+#define WATCH_HEADER_LINES  8
+#define WATCH_DEFAULT_INTERVAL 1
+
+/* Last values drawn for a row of the watch display. */
+struct temp_watch_row {
+    const struct ovsrec_temp_sensor *row;
+    int64_t temperature;
+    char *status;
+    char *fan_state;
+    bool highlighted;
+};
+
+static void
+temp_watch_row_save (struct temp_watch_row *saved,
+                     const struct ovsrec_temp_sensor *row)
+{
+    saved->row = row;
+    saved->temperature = row->temperature;
+    free(saved->status);
+    free(saved->fan_state);
+    saved->status = xstrdup(row->status ? row->status : "");
+    saved->fan_state = xstrdup(row->fan_state ? row->fan_state : "");
+}
+
+static bool
+temp_watch_row_changed (const struct temp_watch_row *saved,
+                        const struct ovsrec_temp_sensor *row)
+{
+    return saved->temperature != row->temperature
+           || strcmp(saved->status, row->status ? row->status : "")
+           || strcmp(saved->fan_state, row->fan_state ? row->fan_state : "");
+}
+
+static void
+temp_watch_draw_row (size_t idx, bool highlight)
+{
+    vty_out(vty, WATCH_GOTO, WATCH_HEADER_LINES + idx + 1);
+    if (highlight)
+    {
+        vty_out(vty, "%s", WATCH_HIGHLIGHT);
+    }
+    vtysh_show_temp_sensor_row(&temp_index[idx], TEMP_FORMAT_BRIEF);
+    if (highlight)
+    {
+        vty_out(vty, "%s", WATCH_NORMAL);
+    }
+}
+
+/*
+ * Function       : temp_watch_draw_all
+ * Responsibility : redraw the whole watch display (used at start, and when
+ *                  sensors are added or removed)
+ */
+static void
+temp_watch_draw_all (struct temp_watch_row **rows, size_t *n_rows,
+                     int interval)
+{
+    size_t i;
+
+    for (i = 0; i < *n_rows; i++)
+    {
+        free((*rows)[i].status);
+        free((*rows)[i].fan_state);
+    }
+    *rows = xrealloc(*rows, (temp_index_n ? temp_index_n : 1) * sizeof **rows);
+    memset(*rows, 0, (temp_index_n ? temp_index_n : 1) * sizeof **rows);
+    *n_rows = temp_index_n;
+
+    vty_out(vty, "%s", WATCH_CLEAR);
+    vty_out(vty, "Every %ds, changes highlighted. Press Enter to stop.%s",
+            interval, VTY_NEWLINE);
+    vty_out(vty, "%s", VTY_NEWLINE);
+    vtysh_show_temp_header(TEMP_FORMAT_BRIEF);
+    for (i = 0; i < temp_index_n; i++)
+    {
+        temp_watch_row_save(&(*rows)[i], temp_index[i].row);
+        temp_watch_draw_row(i, false);
+    }
+}
+
+/*
+ * Function       : temp_watch_layout_changed
+ * Responsibility : check whether the sorted sensor list differs from the
+ *                  one on screen (which needs a full redraw)
+ */
+static bool
+temp_watch_layout_changed (const struct temp_watch_row *rows, size_t n_rows)
+{
+    size_t i;
+
+    if (n_rows != temp_index_n)
+    {
+        return true;
+    }
+    for (i = 0; i < n_rows; i++)
+    {
+        if (rows[i].row != temp_index[i].row)
+        {
+            return true;
+        }
+    }
+    return false;
+}
+
+/*
+ * Function       : vtysh_ovsdb_watch_temp_sensor
+ * Responsibility : display temperature sensors, and redraw only the rows
+ *                  whose temperature, status or fan state changed, until
+ *                  the user presses Enter. Nothing is redrawn while the
+ *                  IDL seqno is unchanged. Rows are only read with the
+ *                  vtysh IDL lock held, and the lock is released while
+ *                  waiting, so the IDL keeps being updated.
+ * Parameters
+ *    interval : seconds between checks for changes
+ */
+static void
+vtysh_ovsdb_watch_temp_sensor (int interval)
+{
+    struct temp_watch_row *rows = NULL;
+    size_t n_rows = 0;
+    unsigned int seqno;
+    size_t i;
+
+    VTYSH_OVSDB_LOCK;
+    temp_index_refresh();
+    seqno = ovsdb_idl_get_seqno(idl);
+    temp_watch_draw_all(&rows, &n_rows, interval);
+    VTYSH_OVSDB_UNLOCK;
+
+    for (;;)
+    {
+        struct pollfd pfd = { .fd = STDIN_FILENO, .events = POLLIN };
+        unsigned int new_seqno;
+        char buf[64];
+
+        vty_out(vty, WATCH_GOTO, WATCH_HEADER_LINES + n_rows + 1);
+        fflush(stdout);
+        if (poll(&pfd, 1, interval * 1000) > 0)
+        {
+            if (read(STDIN_FILENO, buf, sizeof buf) >= 0)
+            {
+                break;
+            }
+        }
+
+        VTYSH_OVSDB_LOCK;
+        new_seqno = ovsdb_idl_get_seqno(idl);
+        if (new_seqno != seqno)
+        {
+            /* Rows may have been deleted while unlocked: look them up
+             * again before touching them. */
+            temp_index_refresh();
+            if (temp_watch_layout_changed(rows, n_rows))
+            {
+                temp_watch_draw_all(&rows, &n_rows, interval);
+                seqno = new_seqno;
+                VTYSH_OVSDB_UNLOCK;
+                continue;
+            }
+        }
+
+        /* Remove the highlight from rows changed on the last refresh. */
+        for (i = 0; i < n_rows; i++)
+        {
+            if (rows[i].highlighted)
+            {
+                rows[i].highlighted = false;
+                temp_watch_draw_row(i, false);
+            }
+        }
+
+        /* Compare every row with what's on screen. */
+        for (i = 0; new_seqno != seqno && i < n_rows; i++)
+        {
+            const struct ovsrec_temp_sensor *row = temp_index[i].row;
+
+            if (temp_watch_row_changed(&rows[i], row))
+            {
+                temp_watch_row_save(&rows[i], row);
+                rows[i].highlighted = true;
+                temp_watch_draw_row(i, true);
+            }
+        }
+        seqno = new_seqno;
+        VTYSH_OVSDB_UNLOCK;
+    }
+
+    for (i = 0; i < n_rows; i++)
+    {
+        free(rows[i].status);
+        free(rows[i].fan_state);
+    }
+    free(rows);
+}
+
+DEFUN (vtysh_show_system_temperature_watch,
+        vtysh_show_system_temperature_watch_cmd,
+        "show system temperature watch",
+        SHOW_STR
+        SYS_STR
+        TEMP_STR
+        TEMP_WATCH_STR)
+{
+    vtysh_ovsdb_watch_temp_sensor (WATCH_DEFAULT_INTERVAL);
+    return CMD_SUCCESS;
+}
+
+DEFUN (vtysh_show_system_temperature_watch_interval,
+        vtysh_show_system_temperature_watch_interval_cmd,
+        "show system temperature watch <1-60>",
+        SHOW_STR
+        SYS_STR
+        TEMP_STR
+        TEMP_WATCH_STR
+        TEMP_WATCH_INTERVAL_STR)
+{
+    vtysh_ovsdb_watch_temp_sensor (atoi(argv[0]));
     return CMD_SUCCESS;
 }
 
@@ -131,17 +671,19 @@ void tempd_ovsdb_init(void)
     /* Add temperature tables. */
     ovsdb_idl_add_table(idl, &ovsrec_table_temp_sensor);
 
-    /*Add temp_sensors into subsystem */
+    /* Add temp_sensors into subsystem (used to group sensors by
+     * subsystem). */
+    ovsdb_idl_add_column(idl, &ovsrec_subsystem_col_name);
     ovsdb_idl_add_column(idl, &ovsrec_subsystem_col_temp_sensors);
 
+    /* Only the columns shown by the CLI (external_ids holds the
+     * rolling statistics). */
     ovsdb_idl_add_column(idl, &ovsrec_temp_sensor_col_external_ids);
     ovsdb_idl_add_column(idl, &ovsrec_temp_sensor_col_fan_state);
-    ovsdb_idl_add_column(idl, &ovsrec_temp_sensor_col_hw_config);
     ovsdb_idl_add_column(idl, &ovsrec_temp_sensor_col_location);
     ovsdb_idl_add_column(idl, &ovsrec_temp_sensor_col_max);
     ovsdb_idl_add_column(idl, &ovsrec_temp_sensor_col_min);
     ovsdb_idl_add_column(idl, &ovsrec_temp_sensor_col_name);
-    ovsdb_idl_add_column(idl, &ovsrec_temp_sensor_col_other_config);;
     ovsdb_idl_add_column(idl, &ovsrec_temp_sensor_col_status);
     ovsdb_idl_add_column(idl, &ovsrec_temp_sensor_col_temperature);
 
@@ -162,4 +704,19 @@ void cli_post_init(void)
     install_element (ENABLE_NODE, &vtysh_show_system_temperature_cmd);
     install_element (VIEW_NODE, &vtysh_show_system_temperature_detail_cmd);
     install_element (ENABLE_NODE, &vtysh_show_system_temperature_detail_cmd);
+    install_element (VIEW_NODE, &vtysh_show_system_temperature_filter_cmd);
+    install_element (ENABLE_NODE, &vtysh_show_system_temperature_filter_cmd);
+    install_element (VIEW_NODE,
+                     &vtysh_show_system_temperature_detail_filter_cmd);
+    install_element (ENABLE_NODE,
+                     &vtysh_show_system_temperature_detail_filter_cmd);
+    install_element (VIEW_NODE, &vtysh_show_system_temperature_compact_cmd);
+    install_element (ENABLE_NODE, &vtysh_show_system_temperature_compact_cmd);
+    install_element (VIEW_NODE,
+                     &vtysh_show_system_temperature_compact_filter_cmd);
+    install_element (ENABLE_NODE,
+                     &vtysh_show_system_temperature_compact_filter_cmd);
+    install_element (ENABLE_NODE, &vtysh_show_system_temperature_watch_cmd);
+    install_element (ENABLE_NODE,
+                     &vtysh_show_system_temperature_watch_interval_cmd);
 }
@@ -40,12 +40,21 @@
 #define _GNU_SOURCE
 #include <stdio.h>
 #include <errno.h>
+#include <fcntl.h>
+#include <fnmatch.h>
 #include <getopt.h>
 #include <limits.h>
+#include <math.h>
 #include <signal.h>
 #include <stdlib.h>
 #include <string.h>
+#include <time.h>
 #include <unistd.h>
+#include <poll.h>
+#include <sys/reboot.h>
+#include <sys/stat.h>
+#include <sys/types.h>
+#include <sys/wait.h>
 #include <dynamic-string.h>
 
 #include "config.h"
@@ -55,9 +64,14 @@
 #include "dirs.h"
 #include "dummy.h"
 #include "fatal-signal.h"
+#include "json.h"
+#include "ovs-atomic.h"
 #include "ovsdb-idl.h"
 #include "poll-loop.h"
+#include "random.h"
 #include "simap.h"
+#include "smap.h"
+#include "sset.h"
 #include "stream-ssl.h"
 #include "stream.h"
 #include "svec.h"
@@ -77,24 +91,117 @@ static struct ovsdb_idl *idl;
 static unsigned int idl_seqno;
 
 static unixctl_cb_func tempd_unixctl_dump;
+static unixctl_cb_func tempd_unixctl_dump_json;
 
 static bool cur_hw_set = false;
 
+// change event socket (see --events), and its clients
+static char *events_path = NULL;
+static struct pstream *events_listener = NULL;
+static struct locl_subscriber **subscribers = NULL;
+static size_t n_subscribers = 0;
+
+// set when a subsystem has been loaded, but its sensors are not in the db
+static bool unpublished_subsystems = false;
+
+// standby: period (in seconds) for reading sensors while another ops-tempd
+// holds the lock (0 = don't read)
+static int standby_read_period = 0;
+static long long int standby_next_read = 0;
+
+// warm-restart state file (see --state-file)
+static char *state_path = NULL;
+
+// flight recorder (see --flight-recorder)
+static char *recorder_path = NULL;
+static long long int recorder_next_flush = 0;
+
+// directory of i2c bus lock files (see --bus-lock-dir), or NULL
+static char *bus_lock_dir = NULL;
+static struct vlog_rate_limit bus_lock_rl = VLOG_RATE_LIMIT_INIT(1, 5);
+static void tempd_bus_lock(struct locl_bus *bus);
+static void tempd_bus_unlock(struct locl_buslock *lock);
+
+// emergency shutdown (see --emergency-action), and the program run in
+// place of the power off command when stubbed
+static enum emergencyaction emergency_action = EMERGENCY_ACTION_POWEROFF;
+static char *emergency_stub = NULL;
+static struct locl_shutdown shutdown_info;
+
+// let test, injected and replayed temperatures start an emergency
+// shutdown (see --simulated-shutdown). otherwise the shutdown is only
+// logged, and counted.
+static bool simulated_shutdown = false;
+static unsigned int simulated_emergencies = 0;
+static struct vlog_rate_limit simulated_rl = VLOG_RATE_LIMIT_INIT(1, 5);
+
+// write rolling statistics to the db (see --publish-stats)
+static bool publish_stats = false;
+static long long int stats_next_publish = 0;
+
+// write sample times and read quality to the db (see --publish-samples)
+static bool publish_samples = false;
+static long long int samples_next_publish = 0;
+
+// takeover: time the lock was acquired, and how long it took until the
+// first poll results were published (msec)
+static bool active = false;
+static long long int lock_acquired_msec = 0;
+static long long int takeover_msec = -1;
+static unsigned int takeovers = 0;
+
+// start of the last poll (-1 = none yet), and number of polls
+static long long int last_poll_msec = -1;
+static unsigned long long int polls = 0;
+
+// read-only queries are served from a snapshot of the sensor state, which
+// is retaken when state_seqno has moved on (bumped by every poll and every
+// configuration change)
+static struct tempd_snapshot *snapshot = NULL;
+static unsigned int state_seqno = 0;
+static void tempd_snapshot_unref(struct tempd_snapshot *snap);
+static void tempd_dump_header(struct ds *ds);
+static void tempd_dump_buses(struct ds *ds);
+
 YamlConfigHandle yaml_handle;
 
 struct shash sensor_data;       // struct locl_sensor (all sensors)
 struct shash subsystem_data;    // struct locl_subsystem
+struct shash bus_data;          // struct locl_bus
+struct shash buslock_data;      // struct locl_buslock
+
+// bus recovery commands still running when their bus was freed, reaped by
+// tempd_bus_reap()
+static pid_t *orphan_pids = NULL;
+static size_t n_orphan_pids = 0;
+
+// virtual time (msec) when replaying traces, otherwise -1
+static long long int virtual_msec = -1;
+
+// current time, in msec (virtual time when replaying traces)
+static long long int
+tempd_time_msec(void)
+{
+    return(virtual_msec >= 0 ? virtual_msec : time_msec());
+}
+
+// convert a time from tempd_time_msec() to wall clock time (-1 stays -1)
+static long long int
+tempd_wall_msec(long long int msec)
+{
+    if (msec < 0) {
+        return(-1);
+    }
+    return(time_wall_msec() - (tempd_time_msec() - msec));
+}
 
 // map sensorstatus enum to the equivalent string
 static const char *
 sensor_status_to_string(enum sensorstatus status)
 {
-    VLOG_DBG("sensor status is %d", status);
     if (status < sizeof(sensor_status)/sizeof(const char *)) {
-        VLOG_DBG("sensor status is %s", sensor_status[status]);
         return(sensor_status[status]);
     } else {
-        VLOG_DBG("sensor status is %s", sensor_status[SENSOR_STATUS_UNINITIALIZED]);
         return(sensor_status[SENSOR_STATUS_UNINITIALIZED]);
     }
 }
@@ -116,6 +223,8 @@ init_subsystems(void)
 {
     shash_init(&subsystem_data);
     shash_init(&sensor_data);
+    shash_init(&bus_data);
+    shash_init(&buslock_data);
 }
 
 // find a sensor (in idl cache) by name
@@ -134,427 +243,3663 @@ lookup_sensor(const char *name)
     return(NULL);
 }
 
-// read the lm75 temperature sensor
-// lm75 has a two-byte temperature output. The first byte is the temperature,
-// and the second byte's highest bit is a half-degree adder
-static void
-lm75_read(struct locl_sensor *sensor)
+// load the optional tempd extension file for a subsystem
+// the file is json, of the form:
+//     { "sensors": { "<sensor number>": { "<key>": <value>, ... }, ... } }
+static struct json *
+tempd_ext_load(const char *subsystem_name, const char *dir)
 {
-    char buf[2];
-    int rc;
-    bool fault = false;
+    struct json *json;
+    char *path;
 
-    const YamlDevice *device = yaml_find_device(
-            yaml_handle,
-            sensor->subsystem->name,
-            sensor->yaml_sensor->device);
+    path = xasprintf("%s/%s", dir, TEMPD_EXT_FILE);
+    if (access(path, R_OK) != 0) {
+        free(path);
+        return(NULL);
+    }
 
-    if (sensor->test_temp != -1) {
-        VLOG_DBG("Test temperature override set to %d", sensor->test_temp);
-        sensor->status = SENSOR_STATUS_NORMAL;
-        sensor->temp = sensor->test_temp;
-        return;
+    json = json_from_file(path);
+    if (json->type != JSON_OBJECT) {
+        VLOG_ERR("Unable to parse %s for subsystem %s: %s", path,
+                 subsystem_name,
+                 json->type == JSON_STRING ? json_string(json) : "not an object");
+        json_destroy(json);
+        json = NULL;
     }
+    free(path);
 
-    rc = i2c_data_read(yaml_handle, device, sensor->subsystem->name, 0,
-                       sizeof(buf), buf);
+    return(json);
+}
 
-    if (0 != rc) {
-        fault = true;
+// find the settings for a sensor (by sensor number) in a section of an
+// extension file
+static const struct shash *
+tempd_ext_entry(const struct json *ext, const char *section, int number)
+{
+    const struct json *sensors;
+    const struct json *entry;
+    char key[16];
+
+    if (ext == NULL) {
+        return(NULL);
     }
 
-    if (true == fault) {
-        // if we've hit the retry limit, mark it as failed
-        if (sensor->fault_count > MAX_FAIL_RETRY) {
-            sensor->status = SENSOR_STATUS_FAILED;
-        }
-        // otherwise, don't change the temp or status, but increment the retry
-        // count
-        sensor->fault_count++;
-        return;
+    sensors = shash_find_data(json_object(ext), section);
+    if (sensors == NULL || sensors->type != JSON_OBJECT) {
+        return(NULL);
     }
 
-    // if we succeeded in reading the temp, then clear the retry count
-    sensor->fault_count = 0;
+    snprintf(key, sizeof(key), "%d", number);
+    entry = shash_find_data(json_object(sensors), key);
+    if (entry == NULL || entry->type != JSON_OBJECT) {
+        return(NULL);
+    }
 
-    if (sensor->status == SENSOR_STATUS_FAILED) {
-        // we need to kick this sensor back into a working state
-        sensor->status = SENSOR_STATUS_NORMAL;
+    return(json_object(entry));
+}
+
+// find the extension settings for a sensor (by sensor number)
+static const struct shash *
+tempd_ext_sensor(const struct locl_subsystem *subsystem, int number)
+{
+    return(tempd_ext_entry(subsystem->ext, "sensors", number));
+}
+
+// get a string value from a sensor's extension settings
+static const char *
+tempd_ext_get_string(const struct shash *ext, const char *key)
+{
+    const struct json *value;
+
+    if (ext == NULL) {
+        return(NULL);
+    }
+    value = shash_find_data(ext, key);
+    if (value == NULL || value->type != JSON_STRING) {
+        return(NULL);
     }
+    return(json_string(value));
+}
 
-    // convert to milidegrees (C)
-    sensor->temp = buf[0] * MILI_DEGREES;
+// get a boolean value from a sensor's extension settings
+static bool
+tempd_ext_get_bool(const struct shash *ext, const char *key)
+{
+    const struct json *value;
 
-    // high bit in second byte is half-degree indicator
-    if (buf[1] < 0) {
-        // half-degree in milidegrees
-        sensor->temp += 500;
+    if (ext == NULL) {
+        return(false);
     }
+    value = shash_find_data(ext, key);
+    return(value != NULL && value->type == JSON_TRUE);
+}
 
-    VLOG_DBG("%s: %4.1fc", sensor->yaml_sensor->device, ((float)sensor->temp)/MILI_DEGREES_FLOAT);
+// get a number (integer or real) from a json value
+static bool
+tempd_json_number(const struct json *value, double *number)
+{
+    if (value == NULL) {
+        return(false);
+    } else if (value->type == JSON_INTEGER) {
+        *number = json_integer(value);
+    } else if (value->type == JSON_REAL) {
+        *number = json_real(value);
+    } else {
+        return(false);
+    }
+    return(true);
 }
 
-// read sensor temperature and calculate status/fan speed setting
-static void
-tempd_read_sensor(struct locl_sensor *sensor)
+// get a number from a sensor's extension settings
+static bool
+tempd_ext_get_number(const struct shash *ext, const char *key, double *number)
 {
-    const YamlSensor *yaml_sensor = sensor->yaml_sensor;
+    if (ext == NULL) {
+        return(false);
+    }
+    return(tempd_json_number(shash_find_data(ext, key), number));
+}
 
-    if (strcmp(yaml_sensor->type, "lm75") == 0) {
-        lm75_read(sensor);
-    } else {
-        VLOG_WARN("Unrecognized sensor type %s", yaml_sensor->type);
-        log_event("TEMP_SENSOR_UNRECOGNIZED", EV_KV("type",
-            "%s", yaml_sensor->type));
-        sensor->temp = DEFAULT_TEMP * MILI_DEGREES;
+// write a single value (in milidegrees) to a sysfs attribute
+static int
+sysfs_write_int(const char *path, int value)
+{
+    FILE *fp;
+    int rc;
+
+    fp = fopen(path, "w");
+    if (fp == NULL) {
+        return(errno);
     }
+    rc = fprintf(fp, "%d\n", value) < 0 ? EIO : 0;
+    if (fclose(fp) != 0 && rc == 0) {
+        rc = errno;
+    }
+    return(rc);
+}
 
-    // recalculate alarm and fan state
+// encode milidegrees as an lm75 limit register (9-bit, msb first)
+static void
+lm75_encode_limit(int temp, char *buf)
+{
+    int half_degrees = temp / 500;
 
-    // decreasing alarms
+    buf[0] = (char)(half_degrees >> 1);
+    buf[1] = (half_degrees & 1) ? 0x80 : 0;
+}
 
-    if (SENSOR_STATUS_FAILED == sensor->status) {
-        // no temp to report, unable to read sensor
+// program the sensor's hardware limits from the alarm thresholds, so the
+// device can raise an alert on its own when the "max" threshold is crossed
+// this is opt-in ("program_limits"), since some boards route the alert
+// output to hardware that acts on it (fans, power).
+static void
+tempd_program_limits(struct locl_sensor *sensor)
+{
+    const YamlSensor *yaml_sensor = sensor->yaml_sensor;
+    const YamlAlarmThresholds *alarm = &yaml_sensor->alarm_thresholds;
+    int max_on;
+    int max_off;
+    int crit;
+    const char *path;
+    int rc;
+
+    if (!tempd_ext_get_bool(sensor->ext, "program_limits")) {
         return;
     }
-
-    // adjust min and max values
-    if (sensor->min > sensor->temp) {
-        sensor->min = sensor->temp;
+    // a disabled threshold (e.g. a delta composite's) has nothing to program
+    if (!isfinite(alarm->max_on) || !isfinite(alarm->max_off) ||
+            !isfinite(alarm->critical_on)) {
+        VLOG_WARN("%s: thresholds are disabled, not programming limits",
+                  sensor->name);
+        return;
     }
-
-    if (sensor->max < sensor->temp) {
-        sensor->max = sensor->temp;
+    max_on = alarm->max_on * MILI_DEGREES;
+    max_off = alarm->max_off * MILI_DEGREES;
+    crit = alarm->critical_on * MILI_DEGREES;
+
+    // hwmon driven sensors expose the limits as sysfs attributes
+    path = tempd_ext_get_string(sensor->ext, "max");
+    if (path != NULL) {
+        rc = sysfs_write_int(path, max_on);
+        if (rc != 0) {
+            VLOG_WARN("%s: unable to write %s (%s)", sensor->name, path,
+                      ovs_strerror(rc));
+        }
+        path = tempd_ext_get_string(sensor->ext, "crit");
+        if (path != NULL && (rc = sysfs_write_int(path, crit)) != 0) {
+            VLOG_WARN("%s: unable to write %s (%s)", sensor->name, path,
+                      ovs_strerror(rc));
+        }
+        return;
     }
 
-    // decreasing alarms
-    if (SENSOR_STATUS_EMERGENCY == sensor->status &&
-            (float)sensor->temp/MILI_DEGREES_FLOAT <= yaml_sensor->alarm_thresholds.emergency_off) {
-        sensor->status = SENSOR_STATUS_CRITICAL;
+    if (strcmp(yaml_sensor->type, "lm75") == 0) {
+        const YamlDevice *device = yaml_find_device(
+                yaml_handle,
+                sensor->subsystem->name,
+                yaml_sensor->device);
+        char buf[2];
+
+        tempd_bus_lock(sensor->bus);
+        lm75_encode_limit(max_off, buf);
+        rc = i2c_data_write(yaml_handle, device, sensor->subsystem->name,
+                            LM75_REG_THYST, sizeof(buf), buf);
+        if (rc == 0) {
+            lm75_encode_limit(max_on, buf);
+            rc = i2c_data_write(yaml_handle, device, sensor->subsystem->name,
+                                LM75_REG_TOS, sizeof(buf), buf);
+        }
+        if (sensor->bus != NULL) {
+            tempd_bus_unlock(sensor->bus->lock);
+        }
+        if (rc != 0) {
+            VLOG_WARN("%s: unable to program lm75 limits", sensor->name);
+        }
     }
+}
 
-    if (SENSOR_STATUS_CRITICAL == sensor->status &&
-            (float)sensor->temp /MILI_DEGREES_FLOAT<= yaml_sensor->alarm_thresholds.critical_off) {
-        sensor->status = SENSOR_STATUS_MAX;
-    }
+// open the sensor's alert attribute (if any) so the main loop can wake up
+// as soon as the device signals an over-temperature condition.
+// the attribute is either a sysfs file (hwmon temp*_alarm, gpio value),
+// which signals with POLLPRI, or a fifo, which signals with POLLIN. a fifo
+// is opened for writing too: with a writer of its own it never reports
+// POLLHUP when the writers go away, which would wake the loop forever.
+static void
+tempd_alert_open(struct locl_sensor *sensor)
+{
+    const char *path = tempd_ext_get_string(sensor->ext, "alert");
+    struct stat st;
+    int flags = O_RDONLY;
+    char buf[16];
 
-    if (SENSOR_STATUS_MAX == sensor->status &&
-            (float)sensor->temp/MILI_DEGREES_FLOAT <= yaml_sensor->alarm_thresholds.max_off) {
-        sensor->status = SENSOR_STATUS_NORMAL;
+    sensor->alert_fd = -1;
+    if (path == NULL) {
+        return;
     }
 
-    if (SENSOR_STATUS_NORMAL == sensor->status &&
-            (float)sensor->temp/MILI_DEGREES_FLOAT > yaml_sensor->alarm_thresholds.low_crit) {
-        sensor->status = SENSOR_STATUS_MIN;
+    if (stat(path, &st) == 0 && S_ISFIFO(st.st_mode)) {
+        flags = O_RDWR;
     }
-
-    if (SENSOR_STATUS_MIN == sensor->status &&
-            (float)sensor->temp/MILI_DEGREES_FLOAT > yaml_sensor->alarm_thresholds.min) {
-        sensor->status = SENSOR_STATUS_NORMAL;
+    sensor->alert_fd = open(path, flags | O_NONBLOCK);
+    if (sensor->alert_fd < 0) {
+        VLOG_WARN("%s: unable to open alert %s (%s)", sensor->name, path,
+                  ovs_strerror(errno));
+        return;
     }
 
-    // increasing alarms
-    if (SENSOR_STATUS_NORMAL == sensor->status &&
-            (float)sensor->temp/MILI_DEGREES_FLOAT >= yaml_sensor->alarm_thresholds.max_on) {
-        sensor->status = SENSOR_STATUS_MAX;
+    // sysfs only notifies pollers after the attribute has been read once
+    while (read(sensor->alert_fd, buf, sizeof(buf)) > 0) {
+        ;
     }
+}
 
-    if (SENSOR_STATUS_MAX == sensor->status &&
-            (float)sensor->temp/MILI_DEGREES_FLOAT >= yaml_sensor->alarm_thresholds.critical_on) {
-        sensor->status = SENSOR_STATUS_CRITICAL;
+// close the sensor's alert attribute
+static void
+tempd_alert_close(struct locl_sensor *sensor)
+{
+    if (sensor->alert_fd >= 0) {
+        close(sensor->alert_fd);
+        sensor->alert_fd = -1;
     }
+}
 
-    if (SENSOR_STATUS_CRITICAL == sensor->status &&
-            (float)sensor->temp/MILI_DEGREES_FLOAT >= yaml_sensor->alarm_thresholds.emergency_on) {
-        sensor->status = SENSOR_STATUS_EMERGENCY;
-    }
+// poll events to wait on for an alert fd
+static short int
+tempd_alert_events(int fd)
+{
+    struct stat st;
 
-    if (SENSOR_STATUS_NORMAL == sensor->status &&
-            (float)sensor->temp/MILI_DEGREES_FLOAT <= yaml_sensor->alarm_thresholds.min) {
-        sensor->status = SENSOR_STATUS_MIN;
+    if (fstat(fd, &st) == 0 && S_ISFIFO(st.st_mode)) {
+        return(POLLIN);
     }
+    return(POLLPRI);
+}
 
-    if (SENSOR_STATUS_MIN == sensor->status &&
-            (float)sensor->temp/MILI_DEGREES_FLOAT <= yaml_sensor->alarm_thresholds.low_crit) {
-        sensor->status = SENSOR_STATUS_LOWCRIT;
+// consume any pending alert notifications, so that the next poll_block()
+// only wakes on new alerts. returns the number of sensors that alerted.
+static int
+tempd_alert_ack(void)
+{
+    struct shash_node *node;
+    int count = 0;
+
+    SHASH_FOR_EACH(node, &sensor_data) {
+        struct locl_sensor *sensor = (struct locl_sensor *)node->data;
+        struct pollfd pfd;
+        char buf[16];
+
+        if (sensor->alert_fd < 0) {
+            continue;
+        }
+
+        pfd.fd = sensor->alert_fd;
+        pfd.events = tempd_alert_events(sensor->alert_fd);
+        pfd.revents = 0;
+        if (poll(&pfd, 1, 0) <= 0 || !(pfd.revents & pfd.events)) {
+            continue;
+        }
+
+        count++;
+        if (pfd.events == POLLPRI) {
+            lseek(sensor->alert_fd, 0, SEEK_SET);
+        }
+        while (read(sensor->alert_fd, buf, sizeof(buf)) > 0) {
+            ;
+        }
+        VLOG_DBG("%s: hardware alert", sensor->name);
     }
 
-    // calculate requested fan speed
-    if (SENSOR_FAN_NORMAL == sensor->fan_speed &&
-            (float)sensor->temp/MILI_DEGREES_FLOAT >= yaml_sensor->fan_thresholds.medium_on) {
-        sensor->fan_speed = SENSOR_FAN_MEDIUM;
+    return(count);
+}
+
+// map breakerstate enum to the equivalent string
+static const char *
+breaker_state_to_string(enum breakerstate state)
+{
+    if (state < sizeof(breaker_state)/sizeof(const char *)) {
+        return(breaker_state[state]);
+    } else {
+        return(breaker_state[BREAKER_CLOSED]);
     }
+}
 
-    if (SENSOR_FAN_MEDIUM == sensor->fan_speed &&
-            (float)sensor->temp/MILI_DEGREES_FLOAT >= yaml_sensor->fan_thresholds.fast_on) {
-        sensor->fan_speed = SENSOR_FAN_FAST;
+// check if a read is allowed through the breaker. an open breaker lets a
+// single probe read through once its backoff has expired.
+static bool
+tempd_breaker_allow(struct locl_breaker *breaker, long long int now)
+{
+    switch (breaker->state) {
+    case BREAKER_OPEN:
+        if (now < breaker->next_probe) {
+            return(false);
+        }
+        breaker->state = BREAKER_HALF_OPEN;
+        return(true);
+    case BREAKER_HALF_OPEN:
+    case BREAKER_CLOSED:
+    default:
+        return(true);
     }
+}
 
-    if (SENSOR_FAN_FAST == sensor->fan_speed &&
-            (float)sensor->temp/MILI_DEGREES_FLOAT >= yaml_sensor->fan_thresholds.max_on) {
-        sensor->fan_speed = SENSOR_FAN_MAX;
+// open the breaker, doubling the backoff if a probe read failed
+static void
+tempd_breaker_trip(struct locl_breaker *breaker, long long int now)
+{
+    if (breaker->state == BREAKER_HALF_OPEN) {
+        breaker->backoff = MIN(breaker->backoff * 2, BREAKER_BACKOFF_MAX_MSEC);
+    } else {
+        breaker->backoff = BREAKER_BACKOFF_MIN_MSEC;
+        breaker->trips++;
     }
+    breaker->state = BREAKER_OPEN;
+    breaker->next_probe = now + breaker->backoff;
+}
 
-    if (SENSOR_FAN_MAX == sensor->fan_speed &&
-            (float)sensor->temp/MILI_DEGREES_FLOAT <= yaml_sensor->fan_thresholds.max_off) {
-        sensor->fan_speed = SENSOR_FAN_FAST;
+// record the result of a read. returns true if the breaker opened.
+static bool
+tempd_breaker_record(struct locl_breaker *breaker, bool ok, int threshold,
+                     long long int now)
+{
+    if (ok) {
+        breaker->state = BREAKER_CLOSED;
+        breaker->failures = 0;
+        breaker->backoff = 0;
+        return(false);
     }
 
-    if (SENSOR_FAN_FAST == sensor->fan_speed &&
-            (float)sensor->temp/MILI_DEGREES_FLOAT <= yaml_sensor->fan_thresholds.fast_off) {
-        sensor->fan_speed = SENSOR_FAN_MEDIUM;
+    breaker->failures++;
+    if (breaker->state == BREAKER_HALF_OPEN ||
+            breaker->failures > threshold) {
+        tempd_breaker_trip(breaker, now);
+        return(true);
     }
+    return(false);
+}
 
-    if (SENSOR_FAN_MEDIUM == sensor->fan_speed &&
-            (float)sensor->temp/MILI_DEGREES_FLOAT <= yaml_sensor->fan_thresholds.medium_off) {
-        sensor->fan_speed = SENSOR_FAN_NORMAL;
+// find (or create) a shared bus lock
+static struct locl_buslock *
+tempd_get_buslock(const char *name)
+{
+    struct locl_buslock *lock;
+
+    lock = shash_find_data(&buslock_data, name);
+    if (lock == NULL) {
+        lock = (struct locl_buslock *)malloc(sizeof(struct locl_buslock));
+        memset(lock, 0, sizeof(struct locl_buslock));
+        lock->name = strdup(name);
+        lock->fd = -1;
+        shash_add(&buslock_data, lock->name, (void *)lock);
     }
+    return(lock);
 }
 
-// create a new locl_subsystem object
-static struct locl_subsystem *
-add_subsystem(const struct ovsrec_subsystem *ovsrec_subsys)
+// start a window of transfers on a bus: take its shared lock (unless the
+// window is already open). reads go ahead without the lock if it can't
+// be had within BUS_LOCK_TIMEOUT_MSEC.
+static void
+tempd_bus_lock(struct locl_bus *bus)
 {
-    struct locl_subsystem *result;
+    struct locl_buslock *lock;
+    long long int start;
     int rc;
-    int idx;
-    struct ovsdb_idl_txn *txn;
-    struct ovsrec_temp_sensor **sensor_array;
-    int sensor_idx;
-    int sensor_count;
-    const char *dir;
-    const YamlThermalInfo *info;
 
-    // create and initialize basic subsystem information
-    VLOG_DBG("Adding new subsystem %s", ovsrec_subsys->name);
-    result = (struct locl_subsystem *)malloc(sizeof(struct locl_subsystem));
-    memset(result, 0, sizeof(struct locl_subsystem));
-    (void)shash_add(&subsystem_data, ovsrec_subsys->name, (void *)result);
-    result->name = strdup(ovsrec_subsys->name);
-    result->marked = false;
-    result->marked = true;
-    result->parent_subsystem = NULL;  // OPS_TODO: find parent subsystem
-    shash_init(&result->subsystem_sensors);
+    if (bus == NULL || bus_lock_dir == NULL || bus->lock->window) {
+        return;
+    }
+    lock = bus->lock;
+    lock->window = true;
+    lock->windows++;
+
+    if (lock->fd < 0) {
+        lock->fd = tempd_i2c_lock_open(bus_lock_dir, lock->name);
+        if (lock->fd < 0) {
+            VLOG_WARN_RL(&bus_lock_rl, "Unable to open lock for i2c bus %s "
+                         "(%s)", lock->name, ovs_strerror(errno));
+            return;
+        }
+    }
 
-    // use a default if the hw_desc_dir has not been populated
-    dir = ovsrec_subsys->hw_desc_dir;
+    start = time_msec();
+    rc = tempd_i2c_lock_acquire(lock->fd, BUS_LOCK_TIMEOUT_MSEC);
+    lock->wait_msec += time_msec() - start;
+    if (rc != 0) {
+        lock->timeouts++;
+        VLOG_WARN_RL(&bus_lock_rl, "Unable to lock i2c bus %s (%s), "
+                     "reading without it", lock->name, ovs_strerror(rc));
+        return;
+    }
+    lock->held = true;
+}
 
-    if (dir == NULL || strlen(dir) == 0) {
-        VLOG_ERR("No h/w description directory for subsystem %s",
-                                        ovsrec_subsys->name);
-        return(NULL);
+// end a window of transfers, releasing the shared lock
+static void
+tempd_bus_unlock(struct locl_buslock *lock)
+{
+    if (lock->held) {
+        tempd_i2c_lock_release(lock->fd);
+        lock->held = false;
     }
+    lock->window = false;
+}
 
-    // since this is a new subsystem, load all of the hardware description
-    // information about devices and sensors (just for this subsystem).
-    // parse sensors and device data for subsystem
-    rc = yaml_add_subsystem(yaml_handle, ovsrec_subsys->name, dir);
+// look up a subsystem's recovery command for a bus, from the tempd
+// extension file:
+//     "bus_recovery": { "<bus name>": "<command>" }
+static const char *
+tempd_bus_recovery_cmd(const struct locl_subsystem *subsystem,
+                       const char *bus_name)
+{
+    const struct json *hooks;
+    const struct json *cmd;
 
-    if (rc != 0) {
-        VLOG_ERR("Error reading h/w description files for subsystem %s",
-                                        ovsrec_subsys->name);
+    if (subsystem->ext == NULL) {
+        return(NULL);
+    }
+    hooks = shash_find_data(json_object(subsystem->ext), "bus_recovery");
+    if (hooks == NULL || hooks->type != JSON_OBJECT) {
+        return(NULL);
+    }
+    cmd = shash_find_data(json_object(hooks), bus_name);
+    if (cmd == NULL || cmd->type != JSON_STRING) {
         return(NULL);
     }
+    return(json_string(cmd));
+}
 
-    // need devices data
-    rc = yaml_parse_devices(yaml_handle, ovsrec_subsys->name);
+// find (or create) the bus structure for a device. a bus shared by
+// several subsystems takes its recovery command from the first one that
+// has one.
+static struct locl_bus *
+tempd_get_bus(const struct locl_subsystem *subsystem, const YamlDevice *device)
+{
+    struct locl_bus *bus;
+    const struct json *hooks;
+    const struct json *cmd;
+    const char *lock_name;
+    const char *recovery;
 
-    if (rc != 0) {
-        VLOG_ERR("Unable to parse subsystem %s devices file (in %s)",
-                                        ovsrec_subsys->name, dir);
+    if (device == NULL || device->bus == NULL) {
         return(NULL);
     }
 
-    // need thermal (sensor) data
-    rc = yaml_parse_thermal(yaml_handle, ovsrec_subsys->name);
+    bus = shash_find_data(&bus_data, device->bus);
+    if (bus == NULL) {
+        bus = (struct locl_bus *)malloc(sizeof(struct locl_bus));
+        memset(bus, 0, sizeof(struct locl_bus));
+        bus->name = strdup(device->bus);
+
+        // buses behind a mux share the lock of the parent bus:
+        //     "bus_locks": { "<bus name>": "<lock name>" }
+        lock_name = bus->name;
+        if (subsystem->ext != NULL) {
+            hooks = shash_find_data(json_object(subsystem->ext), "bus_locks");
+            if (hooks != NULL && hooks->type == JSON_OBJECT) {
+                cmd = shash_find_data(json_object(hooks), bus->name);
+                if (cmd != NULL && cmd->type == JSON_STRING) {
+                    lock_name = json_string(cmd);
+                }
+            }
+        }
+        bus->lock = tempd_get_buslock(lock_name);
+        bus->lock->buses = xrealloc(bus->lock->buses,
+                (bus->lock->n_buses + 1) * sizeof(struct locl_bus *));
+        bus->lock->buses[bus->lock->n_buses++] = bus;
 
-    if (rc != 0) {
-        VLOG_ERR("Unable to parse subsystem %s thermal file (in %s)",
-                                        ovsrec_subsys->name, dir);
-        return(NULL);
+        shash_add(&bus_data, bus->name, (void *)bus);
     }
 
-    // get the thermal info, need it for shutdown flag
-    info = yaml_get_thermal_info(yaml_handle, ovsrec_subsys->name);
-    result->emergency_shutdown = info->auto_shutdown;
+    // the command is copied: the extension file goes away with its
+    // subsystem, and the bus may outlive it
+    recovery = tempd_bus_recovery_cmd(subsystem, bus->name);
+    if (recovery != NULL) {
+        if (bus->recovery == NULL) {
+            bus->recovery = xstrdup(recovery);
+        } else if (strcmp(bus->recovery, recovery) != 0) {
+            VLOG_WARN("%s: ignoring recovery command for bus %s, it already "
+                      "has one", subsystem->name, bus->name);
+        }
+    }
+    return(bus);
+}
+
+// free a bus that has no sensors left (and its lock, if no other bus
+// shares it)
+static void
+tempd_bus_free(struct locl_bus *bus)
+{
+    struct locl_buslock *lock = bus->lock;
+    size_t idx;
+
+    for (idx = 0; idx < lock->n_buses; idx++) {
+        if (lock->buses[idx] == bus) {
+            lock->buses[idx] = lock->buses[--lock->n_buses];
+            break;
+        }
+    }
+    if (lock->n_buses == 0) {
+        shash_find_and_delete(&buslock_data, lock->name);
+        if (lock->fd >= 0) {
+            close(lock->fd);
+        }
+        free(lock->buses);
+        free(lock->name);
+        free(lock);
+    }
+
+    if (bus->recovery_pid != 0 &&
+            waitpid(bus->recovery_pid, NULL, WNOHANG) == 0) {
+        VLOG_INFO("Recovery for bus %s still running after its last "
+                  "sensor was removed", bus->name);
+        orphan_pids = xrealloc(orphan_pids,
+                               (n_orphan_pids + 1) * sizeof *orphan_pids);
+        orphan_pids[n_orphan_pids++] = bus->recovery_pid;
+    }
+    shash_find_and_delete(&bus_data, bus->name);
+    free(bus->sensors);
+    free(bus->recovery);
+    free(bus->name);
+    free(bus);
+}
+
+// add a sensor to its bus's list of sensors
+static void
+tempd_bus_add_sensor(struct locl_sensor *sensor)
+{
+    struct locl_bus *bus = sensor->bus;
+
+    if (bus == NULL) {
+        return;
+    }
+    bus->sensors = xrealloc(bus->sensors,
+            (bus->n_sensors + 1) * sizeof(struct locl_sensor *));
+    bus->sensors[bus->n_sensors++] = sensor;
+}
+
+// remove a sensor from its bus's list of sensors, freeing the bus with
+// its last sensor
+static void
+tempd_bus_remove_sensor(struct locl_sensor *sensor)
+{
+    struct locl_bus *bus = sensor->bus;
+    size_t idx;
+
+    if (bus == NULL) {
+        return;
+    }
+    for (idx = 0; idx < bus->n_sensors; idx++) {
+        if (bus->sensors[idx] == sensor) {
+            bus->sensors[idx] = bus->sensors[--bus->n_sensors];
+            break;
+        }
+    }
+    sensor->bus = NULL;
+    if (bus->n_sensors == 0) {
+        tempd_bus_free(bus);
+    }
+}
+
+// start the bus recovery command (if any) without waiting for it. a
+// standby's shadow reads leave recovery to the active process.
+static void
+tempd_bus_recover(struct locl_bus *bus)
+{
+    pid_t pid;
+
+    if (!active || bus->recovery == NULL || bus->recovery_pid != 0) {
+        return;
+    }
+
+    pid = fork();
+    if (pid == 0) {
+        execl("/bin/sh", "sh", "-c", bus->recovery, (char *)NULL);
+        _exit(127);
+    } else if (pid < 0) {
+        VLOG_WARN("Unable to start recovery for bus %s (%s)", bus->name,
+                  ovs_strerror(errno));
+        return;
+    }
+
+    VLOG_INFO("Started recovery for bus %s", bus->name);
+    bus->recovery_pid = pid;
+    bus->recoveries++;
+}
+
+// reap any finished bus recovery commands
+static void
+tempd_bus_reap(void)
+{
+    struct shash_node *node;
+    int status;
+    size_t idx;
+
+    SHASH_FOR_EACH(node, &bus_data) {
+        struct locl_bus *bus = (struct locl_bus *)node->data;
+        if (bus->recovery_pid != 0 &&
+                waitpid(bus->recovery_pid, &status, WNOHANG) != 0) {
+            bus->recovery_pid = 0;
+        }
+    }
+
+    // and those whose bus has gone
+    for (idx = 0; idx < n_orphan_pids; ) {
+        if (waitpid(orphan_pids[idx], &status, WNOHANG) != 0) {
+            orphan_pids[idx] = orphan_pids[--n_orphan_pids];
+        } else {
+            idx++;
+        }
+    }
+}
+
+// read from an i2c device through the device and bus circuit breakers.
+// a read that fails, or takes longer than I2C_READ_TIMEOUT_MSEC, counts
+// against both breakers. returns ENODEV if a breaker skipped the read.
+static int
+tempd_i2c_read(struct locl_sensor *sensor, const YamlDevice *device,
+               uint32_t offset, size_t len, void *buf)
+{
+    struct locl_bus *bus = sensor->bus;
+    long long int now = tempd_time_msec();
+    long long int done;
+    bool ok;
+    int rc;
+
+    if (bus != NULL && !tempd_breaker_allow(&bus->breaker, now)) {
+        return(ENODEV);
+    }
+    if (!tempd_breaker_allow(&sensor->breaker, now)) {
+        // keep the bus probe pending for a device that is allowed to read
+        if (bus != NULL && bus->breaker.state == BREAKER_HALF_OPEN) {
+            bus->breaker.state = BREAKER_OPEN;
+        }
+        return(ENODEV);
+    }
+
+    // waiting for other daemons doesn't count against the read
+    tempd_bus_lock(bus);
+    now = tempd_time_msec();
+
+    rc = i2c_data_read(yaml_handle, device, sensor->subsystem->name, offset,
+                       len, buf);
+
+    done = tempd_time_msec();
+    sensor->read_msec = done - now;
+    ok = (rc == 0 && sensor->read_msec <= I2C_READ_TIMEOUT_MSEC);
+    if (rc == 0 && !ok) {
+        static struct vlog_rate_limit rl = VLOG_RATE_LIMIT_INIT(1, 5);
+
+        VLOG_WARN_RL(&rl, "%s: i2c read took %d msec", sensor->name,
+                     sensor->read_msec);
+        rc = ETIMEDOUT;
+    }
+
+    if (tempd_breaker_record(&sensor->breaker, ok, MAX_FAIL_RETRY, done)) {
+        VLOG_WARN("%s: device breaker open, next probe in %d msec",
+                  sensor->name, sensor->breaker.backoff);
+    }
+
+    if (bus != NULL) {
+        // a slow read is likely a hung bus: open it right away
+        if (tempd_breaker_record(&bus->breaker, ok,
+                    rc == ETIMEDOUT ? 0 : BUS_FAIL_THRESHOLD, done)) {
+            VLOG_WARN("i2c bus %s breaker open, next probe in %d msec",
+                      bus->name, bus->breaker.backoff);
+            tempd_bus_recover(bus);
+        }
+    }
+
+    return(rc);
+}
+
+// record a failed sensor read
+static void
+tempd_sensor_fault(struct locl_sensor *sensor)
+{
+    // if we've hit the retry limit, mark it as failed
+    if (sensor->fault_count > MAX_FAIL_RETRY) {
+        sensor->status = SENSOR_STATUS_FAILED;
+    }
+    // otherwise, don't change the temp or status, but increment the retry
+    // count
+    sensor->fault_count++;
+}
+
+// record a successful sensor read (in milidegrees)
+static void
+tempd_sensor_ok(struct locl_sensor *sensor, int temp)
+{
+    // if we succeeded in reading the temp, then clear the retry count
+    sensor->fault_count = 0;
+
+    if (sensor->status == SENSOR_STATUS_FAILED) {
+        // we need to kick this sensor back into a working state
+        sensor->status = SENSOR_STATUS_NORMAL;
+    }
+
+    sensor->temp = temp;
+}
+
+// check a reading from the hardware against the sensor's rate of change
+// limit and against its peers. a reading that breaks the rate limit (or
+// a first reading) is accepted if the peers agree with it or, failing
+// that, once PLAUSIBLE_CONFIRM consecutive readings agree on the value.
+// the peer group keeps a running sum of its members' readings, so the
+// check is O(1).
+static bool
+tempd_plausible(struct locl_sensor *sensor, int temp)
+{
+    static struct vlog_rate_limit rl = VLOG_RATE_LIMIT_INIT(1, 5);
+    struct locl_plausibility *check = &sensor->plausibility;
+    struct locl_peergroup *group = check->group;
+    long long int now = tempd_time_msec();
+    long long int limit;
+    int n_peers = 0;
+    int peer_mean = 0;
+    bool peers_ok = false;
+    bool rate_ok = true;
+    bool plausible = false;
+
+    if (group != NULL) {
+        long long int sum = group->sum;
+
+        n_peers = group->n_valid;
+        if (check->valid) {
+            sum -= check->last_temp;
+            n_peers--;
+        }
+        if (n_peers > 0) {
+            peer_mean = sum / n_peers;
+            peers_ok = (abs(temp - peer_mean) <= group->max_spread);
+        }
+    }
+
+    if (check->valid && check->max_rate > 0) {
+        limit = (long long int)check->max_rate * (now - check->last_msec) /
+                MSEC_PER_SEC + PLAUSIBLE_SLACK;
+        rate_ok = (llabs((long long int)temp - check->last_temp) <= limit);
+    }
+
+    if (peers_ok || (rate_ok && (check->valid || n_peers == 0))) {
+        plausible = true;
+    } else {
+        // neither the rate limit nor the peers explain it (a real step,
+        // or a first reading the peers disagree with): wait for the new
+        // value to repeat, so no sensor is rejected forever
+        if (check->confirms > 0 &&
+                abs(temp - check->candidate) <= PLAUSIBLE_SLACK) {
+            check->confirms++;
+        } else {
+            check->candidate = temp;
+            check->confirms = 1;
+        }
+        plausible = (check->confirms >= PLAUSIBLE_CONFIRM);
+    }
+
+    if (!plausible) {
+        check->rejected++;
+        VLOG_WARN_RL(&rl, "%s: implausible reading %.1f C (last %.1f C, "
+                     "peers %.1f C)", sensor->name,
+                     temp / MILI_DEGREES_FLOAT,
+                     check->last_temp / MILI_DEGREES_FLOAT,
+                     peer_mean / MILI_DEGREES_FLOAT);
+        return(false);
+    }
+
+    if (group != NULL) {
+        if (check->valid) {
+            group->sum += temp - check->last_temp;
+        } else {
+            group->sum += temp;
+            group->n_valid++;
+        }
+    }
+    check->valid = true;
+    check->last_temp = temp;
+    check->last_msec = now;
+    check->confirms = 0;
+    return(true);
+}
+
+// record a reading from the hardware (in milidegrees). an implausible
+// reading counts as a failed read, not as a temperature.
+static void
+tempd_sensor_sample(struct locl_sensor *sensor, int temp)
+{
+    if (tempd_plausible(sensor, temp)) {
+        tempd_sensor_ok(sensor, temp);
+    } else {
+        tempd_sensor_fault(sensor);
+    }
+}
+
+// map lm75variant enum to the equivalent string
+static const char *
+lm75_variant_to_string(enum lm75variant variant)
+{
+    if (variant < sizeof(lm75_variant)/sizeof(const char *)) {
+        return(lm75_variant[variant]);
+    } else {
+        return(lm75_variant[LM75_VARIANT_LM75]);
+    }
+}
+
+// get an lm75 sensor's device settings from its extension settings:
+//     "variant": "lm75" (default), "lm75b" or "tmp75"
+//     "resolution": 9 to 12 (tmp75 only, default 12)
+//     "one_shot": true (tmp75 only)
+static void
+lm75_settings(struct locl_sensor *sensor)
+{
+    struct locl_lm75 *lm75 = &sensor->lm75;
+    const char *variant = tempd_ext_get_string(sensor->ext, "variant");
+    double resolution;
+    size_t idx;
+
+    lm75->variant = LM75_VARIANT_LM75;
+    for (idx = 0; variant != NULL && idx < ARRAY_SIZE(lm75_variant); idx++) {
+        if (strcmp(variant, lm75_variant[idx]) == 0) {
+            lm75->variant = idx;
+            break;
+        }
+    }
+    if (variant != NULL && idx == ARRAY_SIZE(lm75_variant)) {
+        VLOG_ERR("%s: unknown lm75 variant %s", sensor->name, variant);
+    }
+
+    switch (lm75->variant) {
+    case LM75_VARIANT_TMP75:
+        lm75->resolution = LM75_RESOLUTION_MAX;
+        if (tempd_ext_get_number(sensor->ext, "resolution", &resolution)) {
+            if (resolution >= LM75_RESOLUTION_MIN &&
+                    resolution <= LM75_RESOLUTION_MAX) {
+                lm75->resolution = resolution;
+            } else {
+                VLOG_ERR("%s: invalid resolution %g", sensor->name,
+                         resolution);
+            }
+        }
+        lm75->one_shot = tempd_ext_get_bool(sensor->ext, "one_shot");
+        break;
+    case LM75_VARIANT_LM75B:
+        lm75->resolution = 11;
+        break;
+    case LM75_VARIANT_LM75:
+    default:
+        lm75->resolution = LM75_RESOLUTION_MIN;
+        break;
+    }
+}
+
+// start a one-shot conversion (the device must be in shutdown mode). the
+// rest of the configuration is as lm75_configure() left it.
+static int
+lm75_trigger(struct locl_sensor *sensor, const YamlDevice *device)
+{
+    uint8_t conf = sensor->lm75.conf | LM75_CONF_ONE_SHOT;
+    int rc;
+
+    rc = i2c_data_write(yaml_handle, device, sensor->subsystem->name,
+                        LM75_REG_CONF, sizeof(conf), &conf);
+    if (rc == 0) {
+        sensor->lm75.triggered_msec = tempd_time_msec();
+    }
+    return(rc);
+}
+
+// set a tmp75's resolution and conversion mode. the other configuration
+// bits (alert mode, polarity, fault queue) are left alone. if the device
+// can't be configured, it's read as a plain lm75.
+static void
+lm75_configure(struct locl_sensor *sensor)
+{
+    struct locl_lm75 *lm75 = &sensor->lm75;
+    const YamlDevice *device;
+    uint8_t conf;
+    int rc;
+
+    if (lm75->variant != LM75_VARIANT_TMP75 || sensor->trace != NULL) {
+        return;
+    }
+
+    device = yaml_find_device(yaml_handle, sensor->subsystem->name,
+                              sensor->yaml_sensor->device);
+    tempd_bus_lock(sensor->bus);
+    rc = i2c_data_read(yaml_handle, device, sensor->subsystem->name,
+                       LM75_REG_CONF, sizeof(conf), &conf);
+    if (rc == 0) {
+        conf &= ~(LM75_CONF_RES_MASK | LM75_CONF_SHUTDOWN |
+                  LM75_CONF_ONE_SHOT);
+        conf |= (lm75->resolution - LM75_RESOLUTION_MIN) <<
+                LM75_CONF_RES_SHIFT;
+        if (lm75->one_shot) {
+            // shutdown mode, and start the first conversion
+            conf |= LM75_CONF_SHUTDOWN | LM75_CONF_ONE_SHOT;
+        }
+        rc = i2c_data_write(yaml_handle, device, sensor->subsystem->name,
+                            LM75_REG_CONF, sizeof(conf), &conf);
+    }
+    if (sensor->bus != NULL) {
+        tempd_bus_unlock(sensor->bus->lock);
+    }
+
+    if (rc != 0) {
+        VLOG_WARN("%s: unable to configure tmp75, reading it as an lm75",
+                  sensor->name);
+        lm75->resolution = LM75_RESOLUTION_MIN;
+        lm75->one_shot = false;
+        return;
+    }
+    lm75->conf = conf & ~LM75_CONF_ONE_SHOT;
+    lm75->triggered_msec = tempd_time_msec();
+}
+
+// convert an lm75 temperature register to milidegrees (C), ignoring the
+// bits below the resolution
+static int
+lm75_decode(const uint8_t *buf, int resolution)
+{
+    int16_t raw = (int16_t)((buf[0] << 8) | buf[1]);
+
+    raw &= ~((1 << (16 - resolution)) - 1);
+    return(raw * MILI_DEGREES / 256);
+}
+
+// convert milidegrees to what an lm75 temperature register would hold: the
+// temperature in 1/256 degrees, rounded down (as the part does)
+static void
+lm75_encode(int temp, uint8_t *buf)
+{
+    long long int scaled = (long long int)temp * 256;
+    long long int raw = scaled >= 0 ? scaled / MILI_DEGREES :
+                        -((-scaled + MILI_DEGREES - 1) / MILI_DEGREES);
+
+    raw = MAX(INT16_MIN, MIN(INT16_MAX, raw));
+    buf[0] = (uint8_t)((uint16_t)raw >> 8);
+    buf[1] = (uint8_t)raw;
+}
+
+// read the lm75 temperature sensor
+// the temperature register is a 16-bit two's complement value (msb first)
+// in 1/256 degrees, of which the top "resolution" bits are valid
+static void
+lm75_read(struct locl_sensor *sensor)
+{
+    struct locl_lm75 *lm75 = &sensor->lm75;
+    uint8_t buf[2];
+    int rc;
+    int temp;
+
+    const YamlDevice *device = yaml_find_device(
+            yaml_handle,
+            sensor->subsystem->name,
+            sensor->yaml_sensor->device);
+
+    if (sensor->test_temp != -1) {
+        VLOG_DBG("Test temperature override set to %d", sensor->test_temp);
+        sensor->status = SENSOR_STATUS_NORMAL;
+        sensor->temp = sensor->test_temp;
+        return;
+    }
+
+    if (lm75->one_shot) {
+        // a read right after the previous one (the emergency re-read)
+        // waits for the conversion it started, rather than reading the
+        // same value again. the conversion is up to 220 ms, so the bus
+        // lock window ends first: the next transfer opens a new one.
+        long long int wait = lm75->triggered_msec +
+                             LM75_CONV_MSEC(lm75->resolution) -
+                             tempd_time_msec();
+
+        if (wait > 0 && virtual_msec < 0) {
+            struct timespec delay = { 0, wait * 1000 * 1000 };
+
+            if (sensor->bus != NULL) {
+                tempd_bus_unlock(sensor->bus->lock);
+            }
+            nanosleep(&delay, NULL);
+        }
+    }
+
+    rc = tempd_i2c_read(sensor, device, LM75_REG_TEMP, sizeof(buf), buf);
+
+    if (0 != rc) {
+        tempd_sensor_fault(sensor);
+        return;
+    }
+
+    // the active process starts the next conversion; a standby's shadow
+    // read takes whatever the last one was
+    if (lm75->one_shot && (active || virtual_msec >= 0) &&
+            lm75_trigger(sensor, device) != 0) {
+        static struct vlog_rate_limit rl = VLOG_RATE_LIMIT_INIT(1, 5);
+
+        VLOG_WARN_RL(&rl, "%s: unable to start a conversion", sensor->name);
+    }
+
+    temp = lm75_decode(buf, lm75->resolution);
+
+    tempd_sensor_sample(sensor, temp);
+
+    VLOG_DBG("%s: %4.1fc", sensor->yaml_sensor->device, ((float)sensor->temp)/MILI_DEGREES_FLOAT);
+}
+
+// "read" a sensor from its trace: the last sample at or before the
+// current (virtual) time. an lm75's samples go through its temperature
+// register, so they are reported at the part's resolution.
+static void
+tempd_trace_read(struct locl_sensor *sensor)
+{
+    struct locl_trace *trace = sensor->trace;
+    long long int now = tempd_time_msec();
+    int temp;
+
+    while (trace->pos + 1 < trace->n && trace->msec[trace->pos + 1] <= now) {
+        trace->pos++;
+    }
+
+    if (trace->n == 0 || trace->temp[trace->pos] == TRACE_FAULT) {
+        tempd_sensor_fault(sensor);
+        return;
+    }
+
+    temp = trace->temp[trace->pos];
+    if (strcmp(sensor->yaml_sensor->type, "lm75") == 0) {
+        uint8_t buf[2];
+
+        lm75_encode(temp, buf);
+        temp = lm75_decode(buf, sensor->lm75.resolution);
+    }
+    tempd_sensor_sample(sensor, temp);
+}
+
+// map injectprofile enum to the equivalent string
+static const char *
+inject_profile_to_string(enum injectprofile profile)
+{
+    if (profile < sizeof(inject_profile)/sizeof(const char *)) {
+        return(inject_profile[profile]);
+    } else {
+        return(inject_profile[INJECT_STEP]);
+    }
+}
+
+// "read" a sensor from its injected profile. the profile is removed once
+// its duration has elapsed, and the sensor goes back to the hardware.
+static bool
+tempd_inject_read(struct locl_sensor *sensor)
+{
+    struct locl_inject *inject = sensor->inject;
+    long long int elapsed = tempd_time_msec() - inject->start;
+    double seconds = (double)elapsed / MSEC_PER_SEC;
+    double temp;
+
+    if (elapsed >= inject->duration) {
+        VLOG_DBG("%s: %s injection done", sensor->name,
+                 inject_profile_to_string(inject->profile));
+        free(inject);
+        sensor->inject = NULL;
+        return(false);
+    }
+
+    switch (inject->profile) {
+    case INJECT_RAMP:
+        temp = inject->arg[0] + (inject->arg[1] - inject->arg[0]) *
+               elapsed / inject->duration;
+        break;
+    case INJECT_SINE:
+        temp = inject->arg[0] +
+               inject->arg[1] * sin(2 * M_PI * seconds / inject->arg[2]);
+        break;
+    case INJECT_WALK:
+        // uniform step in [-step, step]
+        inject->walk += inject->arg[1] *
+                        ((double)random_uint32() / UINT32_MAX * 2 - 1);
+        temp = inject->walk;
+        break;
+    case INJECT_STEP:
+    default:
+        temp = inject->arg[0];
+        break;
+    }
+
+    tempd_sensor_ok(sensor, lround(temp * MILI_DEGREES));
+    return(true);
+}
+
+// map compositeop enum to the equivalent string
+static const char *
+composite_op_to_string(enum compositeop op)
+{
+    if (op < sizeof(composite_op)/sizeof(const char *)) {
+        return(composite_op[op]);
+    } else {
+        return(composite_op[COMPOSITE_MAX]);
+    }
+}
+
+// map a string to the equivalent compositeop enum (max if not given)
+static bool
+composite_op_from_string(const char *name, enum compositeop *op)
+{
+    size_t idx;
+
+    *op = COMPOSITE_MAX;
+    if (name == NULL) {
+        return(true);
+    }
+    for (idx = 0; idx < ARRAY_SIZE(composite_op); idx++) {
+        if (strcmp(name, composite_op[idx]) == 0) {
+            *op = idx;
+            return(true);
+        }
+    }
+    return(false);
+}
+
+// "read" a composite sensor by combining its inputs. failed inputs are
+// left out; the composite fails if there is nothing left to combine.
+static void
+tempd_composite_read(struct locl_sensor *sensor)
+{
+    const struct locl_composite *composite = sensor->composite;
+    long long int sum = 0;
+    int temp = 0;
+    int count = 0;
+    size_t idx;
+
+    if (sensor->test_temp != -1) {
+        VLOG_DBG("Test temperature override set to %d", sensor->test_temp);
+        sensor->status = SENSOR_STATUS_NORMAL;
+        sensor->temp = sensor->test_temp;
+        return;
+    }
+
+    for (idx = 0; idx < composite->n_inputs; idx++) {
+        const struct locl_sensor *input = composite->inputs[idx];
+
+        if (input->status == SENSOR_STATUS_FAILED) {
+            if (composite->op == COMPOSITE_DELTA) {
+                count = 0;
+                break;
+            }
+            continue;
+        }
+
+        switch (composite->op) {
+        case COMPOSITE_MIN:
+            temp = (count == 0) ? input->temp : MIN(temp, input->temp);
+            break;
+        case COMPOSITE_AVG:
+            sum += input->temp;
+            break;
+        case COMPOSITE_DELTA:
+            temp = (count == 0) ? input->temp : temp - input->temp;
+            break;
+        case COMPOSITE_MAX:
+        default:
+            temp = (count == 0) ? input->temp : MAX(temp, input->temp);
+            break;
+        }
+        count++;
+    }
+
+    if (count == 0) {
+        // the inputs have already been through their own retries
+        sensor->status = SENSOR_STATUS_FAILED;
+        sensor->fault_count++;
+        return;
+    }
+
+    if (composite->op == COMPOSITE_AVG) {
+        temp = sum / count;
+    }
+
+    tempd_sensor_ok(sensor, temp);
+}
+
+// free a composite sensor's definition (and the strings it owns)
+static void
+tempd_composite_free(struct locl_sensor *sensor)
+{
+    struct locl_composite *composite = sensor->composite;
+
+    if (composite == NULL) {
+        return;
+    }
+    free(sensor->yaml_sensor->location);
+    free(sensor->yaml_sensor->device);
+    free(sensor->yaml_sensor->type);
+    free(composite->inputs);
+    free(composite);
+    sensor->composite = NULL;
+}
+
+// force a composite sensor to be evaluated on the next poll (its value
+// no longer follows from its inputs, e.g. after a test override)
+static void
+tempd_composite_touch(struct locl_sensor *sensor)
+{
+    if (sensor->composite != NULL) {
+        sensor->composite->dirty = true;
+    }
+}
+
+// mark the composites that use a sensor for evaluation, if the sensor's
+// temperature (or whether it failed) changed since the given values
+static void
+tempd_mark_dependents(const struct locl_sensor *sensor, int temp,
+                      enum sensorstatus status)
+{
+    size_t idx;
+
+    if (sensor->temp == temp &&
+            (sensor->status == SENSOR_STATUS_FAILED) ==
+            (status == SENSOR_STATUS_FAILED)) {
+        return;
+    }
+    for (idx = 0; idx < sensor->n_dependents; idx++) {
+        sensor->dependents[idx]->composite->dirty = true;
+    }
+}
+
+// map dutymode enum to the equivalent string
+static const char *
+duty_mode_to_string(enum dutymode mode)
+{
+    if (mode < sizeof(duty_mode)/sizeof(const char *)) {
+        return(duty_mode[mode]);
+    } else {
+        return(duty_mode[DUTY_CURVE]);
+    }
+}
+
+// parse the points of a fan duty curve: [ [ <degrees C>, <duty %> ], ... ]
+// with increasing temperatures
+static bool
+tempd_duty_curve(struct locl_fanduty *duty, const struct json *points)
+{
+    size_t idx;
+
+    if (points == NULL || points->type != JSON_ARRAY ||
+            json_array(points)->n == 0) {
+        return(false);
+    }
+
+    duty->n_points = json_array(points)->n;
+    duty->curve_temp = xmalloc(duty->n_points * sizeof(double));
+    duty->curve_duty = xmalloc(duty->n_points * sizeof(double));
+    for (idx = 0; idx < duty->n_points; idx++) {
+        const struct json *point = json_array(points)->elems[idx];
+
+        if (point->type != JSON_ARRAY || json_array(point)->n != 2 ||
+                !tempd_json_number(json_array(point)->elems[0],
+                                   &duty->curve_temp[idx]) ||
+                !tempd_json_number(json_array(point)->elems[1],
+                                   &duty->curve_duty[idx]) ||
+                (idx > 0 &&
+                 duty->curve_temp[idx] <= duty->curve_temp[idx - 1])) {
+            return(false);
+        }
+    }
+    return(true);
+}
+
+static void
+tempd_duty_free(struct locl_sensor *sensor)
+{
+    if (sensor->duty == NULL) {
+        return;
+    }
+    free(sensor->duty->curve_temp);
+    free(sensor->duty->curve_duty);
+    free(sensor->duty);
+    sensor->duty = NULL;
+}
+
+// create a sensor's fan duty controller from its extension settings:
+//     "fan_duty": { "mode": "curve",
+//                   "points": [ [ <degrees C>, <duty %> ], ... ], ... }
+//     "fan_duty": { "mode": "pi", "setpoint": <degrees C>,
+//                   "kp": <% per C>, "ki": <% per C per second>, ... }
+// with the optional "trend" (% per C/minute of rise), "min" and "max"
+// (%) for either mode.
+static void
+tempd_duty_create(struct locl_sensor *sensor)
+{
+    const struct json *settings = NULL;
+    const struct shash *config;
+    struct locl_fanduty *duty;
+    bool ok;
+
+    if (sensor->ext != NULL) {
+        settings = shash_find_data(sensor->ext, "fan_duty");
+    }
+    if (settings == NULL) {
+        return;
+    }
+
+    duty = (struct locl_fanduty *)malloc(sizeof(struct locl_fanduty));
+    memset(duty, 0, sizeof(struct locl_fanduty));
+    duty->min_duty = 0;
+    duty->max_duty = 100;
+    duty->published = -1;
+    sensor->duty = duty;
+
+    ok = (settings->type == JSON_OBJECT);
+    if (ok) {
+        const char *mode;
+
+        config = json_object(settings);
+        mode = tempd_ext_get_string(config, "mode");
+        if (mode == NULL || strcmp(mode, duty_mode[DUTY_CURVE]) == 0) {
+            duty->mode = DUTY_CURVE;
+            ok = tempd_duty_curve(duty, shash_find_data(config, "points"));
+        } else if (strcmp(mode, duty_mode[DUTY_PI]) == 0) {
+            duty->mode = DUTY_PI;
+            ok = tempd_ext_get_number(config, "setpoint", &duty->setpoint) &&
+                 tempd_ext_get_number(config, "kp", &duty->kp);
+            (void)tempd_ext_get_number(config, "ki", &duty->ki);
+        } else {
+            ok = false;
+        }
+        (void)tempd_ext_get_number(config, "trend", &duty->trend);
+        (void)tempd_ext_get_number(config, "min", &duty->min_duty);
+        (void)tempd_ext_get_number(config, "max", &duty->max_duty);
+        duty->min_duty = MAX(duty->min_duty, 0);
+        duty->max_duty = MIN(duty->max_duty, 100);
+        ok = ok && duty->min_duty <= duty->max_duty;
+    }
+
+    if (!ok) {
+        VLOG_ERR("Invalid fan_duty settings for sensor %s", sensor->name);
+        tempd_duty_free(sensor);
+        return;
+    }
+    duty->duty = duty->min_duty;
+}
+
+// update a sensor's fan duty request from its temperature and its rate of
+// rise
+static void
+tempd_duty_update(struct locl_sensor *sensor)
+{
+    struct locl_fanduty *duty = sensor->duty;
+    long long int now = tempd_time_msec();
+    double temp = sensor->temp / MILI_DEGREES_FLOAT;
+    double seconds = 0;
+    double error;
+    double value;
+    size_t idx;
+
+    // a held value is the last good reading, not the temperature now:
+    // keep the request until the sensor reads again (or fails), and
+    // start the rate of rise over when it does
+    if (sensor->composite == NULL && sensor->fault_count > 0) {
+        duty->primed = false;
+        return;
+    }
+
+    // the rate of rise needs readings at least a second apart (not, for
+    // example, the emergency re-read)
+    if (!duty->primed) {
+        duty->primed = true;
+        duty->last_temp = sensor->temp;
+        duty->last_msec = now;
+    } else if (now - duty->last_msec >= MSEC_PER_SEC) {
+        seconds = (double)(now - duty->last_msec) / MSEC_PER_SEC;
+        duty->slope += DUTY_SLOPE_WEIGHT *
+                       ((sensor->temp - duty->last_temp) / MILI_DEGREES_FLOAT *
+                        60 / seconds - duty->slope);
+        duty->last_temp = sensor->temp;
+        duty->last_msec = now;
+    }
+
+    switch (duty->mode) {
+    case DUTY_PI:
+        error = temp - duty->setpoint;
+        value = duty->kp * error + duty->integral +
+                duty->ki * error * seconds;
+        // don't wind up the integral while the output is saturated
+        if ((value < duty->max_duty || error < 0) &&
+                (value > duty->min_duty || error > 0)) {
+            duty->integral += duty->ki * error * seconds;
+        }
+        value = duty->kp * error + duty->integral;
+        break;
+    case DUTY_CURVE:
+    default:
+        if (temp <= duty->curve_temp[0]) {
+            value = duty->curve_duty[0];
+        } else if (temp >= duty->curve_temp[duty->n_points - 1]) {
+            value = duty->curve_duty[duty->n_points - 1];
+        } else {
+            for (idx = 1; duty->curve_temp[idx] < temp; idx++) {
+                ;
+            }
+            value = duty->curve_duty[idx - 1] +
+                    (duty->curve_duty[idx] - duty->curve_duty[idx - 1]) *
+                    (temp - duty->curve_temp[idx - 1]) /
+                    (duty->curve_temp[idx] - duty->curve_temp[idx - 1]);
+        }
+        break;
+    }
+
+    value += duty->trend * duty->slope;
+    duty->duty = MIN(MAX(value, duty->min_duty), duty->max_duty);
+}
+
+// check if a fan duty request has moved far enough from the published
+// value to be written (limits are always written)
+static bool
+tempd_duty_due(const struct locl_fanduty *duty)
+{
+    int value = lround(duty->duty);
+
+    if (duty->published < 0) {
+        return(true);
+    }
+    if (value == duty->published) {
+        return(false);
+    }
+    return(abs(value - duty->published) >= DUTY_DEADBAND ||
+           value <= duty->min_duty || value >= duty->max_duty);
+}
+
+// map readquality enum to the equivalent string
+static const char *
+read_quality_to_string(enum readquality quality)
+{
+    if (quality < sizeof(read_quality)/sizeof(const char *)) {
+        return(read_quality[quality]);
+    } else {
+        return(read_quality[READ_QUALITY_FAILED]);
+    }
+}
+
+// note where a sensor's value came from after a read, and when it was
+// last good. a composite is as good as its worst input, and as old as its
+// oldest.
+static void
+tempd_sensor_quality(struct locl_sensor *sensor)
+{
+    const struct locl_composite *composite = sensor->composite;
+    enum readquality quality = READ_QUALITY_OK;
+    long long int sample_msec = tempd_time_msec();
+    size_t idx;
+
+    if (sensor->status == SENSOR_STATUS_FAILED) {
+        quality = READ_QUALITY_FAILED;
+    } else if (sensor->test_temp != -1 || sensor->inject != NULL ||
+            sensor->trace != NULL) {
+        quality = READ_QUALITY_SIMULATED;
+    } else if (composite != NULL) {
+        for (idx = 0; idx < composite->n_inputs; idx++) {
+            const struct locl_sensor *input = composite->inputs[idx];
+
+            if (input->quality == READ_QUALITY_FAILED) {
+                // left out of the composite
+                quality = MAX(quality, READ_QUALITY_HELD);
+                continue;
+            }
+            quality = MAX(quality, input->quality);
+            if (input->sample_msec >= 0) {
+                sample_msec = MIN(sample_msec, input->sample_msec);
+            }
+        }
+        sensor->quality = quality;
+        sensor->sample_msec = sample_msec;
+        return;
+    } else if (strcmp(sensor->yaml_sensor->type, "lm75") != 0) {
+        quality = READ_QUALITY_DEFAULT;
+    } else if (sensor->fault_count > 0) {
+        quality = READ_QUALITY_HELD;
+    }
+
+    // a held or failed value keeps the time of the last good one
+    sensor->quality = quality;
+    if (quality != READ_QUALITY_HELD && quality != READ_QUALITY_FAILED) {
+        sensor->sample_msec = sample_msec;
+    }
+}
+
+// read sensor temperature and calculate status/fan speed setting
+static void
+tempd_read_sensor(struct locl_sensor *sensor)
+{
+    const YamlSensor *yaml_sensor = sensor->yaml_sensor;
+
+    if (sensor->inject != NULL && tempd_inject_read(sensor)) {
+        // temperature comes from the injected profile
+    } else if (sensor->composite != NULL) {
+        tempd_composite_read(sensor);
+    } else if (sensor->trace != NULL) {
+        tempd_trace_read(sensor);
+    } else if (strcmp(yaml_sensor->type, "lm75") == 0) {
+        lm75_read(sensor);
+    } else {
+        // logged once per sensor, not on every read
+        if (!sensor->log.unrecognized) {
+            sensor->log.unrecognized = true;
+            VLOG_WARN("%s: unrecognized sensor type %s, reporting %d C",
+                      sensor->name, yaml_sensor->type, DEFAULT_TEMP);
+            log_event("TEMP_SENSOR_UNRECOGNIZED", EV_KV("type",
+                "%s", yaml_sensor->type));
+        }
+        sensor->temp = DEFAULT_TEMP * MILI_DEGREES;
+    }
+    tempd_sensor_quality(sensor);
+
+    // recalculate alarm and fan state
+
+    // decreasing alarms
+
+    if (SENSOR_STATUS_FAILED == sensor->status) {
+        // no temp to report, unable to read sensor. fail safe: ask for
+        // full cooling rather than hold a request that may be too low
+        if (sensor->duty != NULL) {
+            sensor->duty->duty = sensor->duty->max_duty;
+            sensor->duty->primed = false;
+        }
+        return;
+    }
+
+    // adjust min and max values
+    if (sensor->min > sensor->temp) {
+        sensor->min = sensor->temp;
+    }
+
+    if (sensor->max < sensor->temp) {
+        sensor->max = sensor->temp;
+    }
+
+    // decreasing alarms
+    if (SENSOR_STATUS_EMERGENCY == sensor->status &&
+            (float)sensor->temp/MILI_DEGREES_FLOAT <= yaml_sensor->alarm_thresholds.emergency_off) {
+        sensor->status = SENSOR_STATUS_CRITICAL;
+    }
+
+    if (SENSOR_STATUS_CRITICAL == sensor->status &&
+            (float)sensor->temp /MILI_DEGREES_FLOAT<= yaml_sensor->alarm_thresholds.critical_off) {
+        sensor->status = SENSOR_STATUS_MAX;
+    }
+
+    if (SENSOR_STATUS_MAX == sensor->status &&
+            (float)sensor->temp/MILI_DEGREES_FLOAT <= yaml_sensor->alarm_thresholds.max_off) {
+        sensor->status = SENSOR_STATUS_NORMAL;
+    }
+
+    if (SENSOR_STATUS_NORMAL == sensor->status &&
+            (float)sensor->temp/MILI_DEGREES_FLOAT > yaml_sensor->alarm_thresholds.low_crit) {
+        sensor->status = SENSOR_STATUS_MIN;
+    }
+
+    if (SENSOR_STATUS_MIN == sensor->status &&
+            (float)sensor->temp/MILI_DEGREES_FLOAT > yaml_sensor->alarm_thresholds.min) {
+        sensor->status = SENSOR_STATUS_NORMAL;
+    }
+
+    // increasing alarms
+    if (SENSOR_STATUS_NORMAL == sensor->status &&
+            (float)sensor->temp/MILI_DEGREES_FLOAT >= yaml_sensor->alarm_thresholds.max_on) {
+        sensor->status = SENSOR_STATUS_MAX;
+    }
+
+    if (SENSOR_STATUS_MAX == sensor->status &&
+            (float)sensor->temp/MILI_DEGREES_FLOAT >= yaml_sensor->alarm_thresholds.critical_on) {
+        sensor->status = SENSOR_STATUS_CRITICAL;
+    }
+
+    if (SENSOR_STATUS_CRITICAL == sensor->status &&
+            (float)sensor->temp/MILI_DEGREES_FLOAT >= yaml_sensor->alarm_thresholds.emergency_on) {
+        sensor->status = SENSOR_STATUS_EMERGENCY;
+    }
+
+    if (SENSOR_STATUS_NORMAL == sensor->status &&
+            (float)sensor->temp/MILI_DEGREES_FLOAT <= yaml_sensor->alarm_thresholds.min) {
+        sensor->status = SENSOR_STATUS_MIN;
+    }
+
+    if (SENSOR_STATUS_MIN == sensor->status &&
+            (float)sensor->temp/MILI_DEGREES_FLOAT <= yaml_sensor->alarm_thresholds.low_crit) {
+        sensor->status = SENSOR_STATUS_LOWCRIT;
+    }
+
+    // calculate requested fan speed
+    if (SENSOR_FAN_NORMAL == sensor->fan_speed &&
+            (float)sensor->temp/MILI_DEGREES_FLOAT >= yaml_sensor->fan_thresholds.medium_on) {
+        sensor->fan_speed = SENSOR_FAN_MEDIUM;
+    }
+
+    if (SENSOR_FAN_MEDIUM == sensor->fan_speed &&
+            (float)sensor->temp/MILI_DEGREES_FLOAT >= yaml_sensor->fan_thresholds.fast_on) {
+        sensor->fan_speed = SENSOR_FAN_FAST;
+    }
+
+    if (SENSOR_FAN_FAST == sensor->fan_speed &&
+            (float)sensor->temp/MILI_DEGREES_FLOAT >= yaml_sensor->fan_thresholds.max_on) {
+        sensor->fan_speed = SENSOR_FAN_MAX;
+    }
+
+    if (SENSOR_FAN_MAX == sensor->fan_speed &&
+            (float)sensor->temp/MILI_DEGREES_FLOAT <= yaml_sensor->fan_thresholds.max_off) {
+        sensor->fan_speed = SENSOR_FAN_FAST;
+    }
+
+    if (SENSOR_FAN_FAST == sensor->fan_speed &&
+            (float)sensor->temp/MILI_DEGREES_FLOAT <= yaml_sensor->fan_thresholds.fast_off) {
+        sensor->fan_speed = SENSOR_FAN_MEDIUM;
+    }
+
+    if (SENSOR_FAN_MEDIUM == sensor->fan_speed &&
+            (float)sensor->temp/MILI_DEGREES_FLOAT <= yaml_sensor->fan_thresholds.medium_off) {
+        sensor->fan_speed = SENSOR_FAN_NORMAL;
+    }
+
+    // calculate the continuous fan duty request (if configured)
+    if (sensor->duty != NULL) {
+        tempd_duty_update(sensor);
+    }
+}
+
+// set a threshold (degrees C) from a json object, if it's there
+static void
+tempd_ext_threshold(const struct json *thresholds, const char *key,
+                    float *value)
+{
+    const struct json *number;
+
+    if (thresholds == NULL || thresholds->type != JSON_OBJECT) {
+        return;
+    }
+    number = shash_find_data(json_object(thresholds), key);
+    if (number == NULL) {
+        return;
+    } else if (number->type == JSON_INTEGER) {
+        *value = json_integer(number);
+    } else if (number->type == JSON_REAL) {
+        *value = json_real(number);
+    }
+}
+
+// find a sensor in a subsystem by its number
+static struct locl_sensor *
+tempd_find_sensor(const struct locl_subsystem *subsystem, int number)
+{
+    char *sensor_name = xasprintf("%s-%d", subsystem->name, number);
+    struct locl_sensor *sensor;
+
+    sensor = shash_find_data(&subsystem->subsystem_sensors, sensor_name);
+    free(sensor_name);
+    return(sensor);
+}
+
+// set a composite sensor's thresholds from its extension settings.
+// thresholds that aren't given are the same as the first input's, except
+// for a delta: a difference isn't a temperature, so its thresholds are
+// disabled unless given.
+static void
+tempd_composite_thresholds(YamlSensor *yaml,
+                           const struct locl_composite *composite,
+                           const struct shash *settings)
+{
+    const YamlSensor *first = composite->inputs[0]->yaml_sensor;
+    const struct json *alarm = NULL;
+    const struct json *fan = NULL;
+
+    if (settings != NULL) {
+        alarm = shash_find_data(settings, "alarm_thresholds");
+        fan = shash_find_data(settings, "fan_thresholds");
+    }
+
+    if (composite->op == COMPOSITE_DELTA) {
+        yaml->alarm_thresholds.emergency_on = INFINITY;
+        yaml->alarm_thresholds.emergency_off = INFINITY;
+        yaml->alarm_thresholds.critical_on = INFINITY;
+        yaml->alarm_thresholds.critical_off = INFINITY;
+        yaml->alarm_thresholds.max_on = INFINITY;
+        yaml->alarm_thresholds.max_off = INFINITY;
+        yaml->alarm_thresholds.min = -INFINITY;
+        yaml->alarm_thresholds.low_crit = -INFINITY;
+        yaml->fan_thresholds.max_on = INFINITY;
+        yaml->fan_thresholds.max_off = INFINITY;
+        yaml->fan_thresholds.fast_on = INFINITY;
+        yaml->fan_thresholds.fast_off = INFINITY;
+        yaml->fan_thresholds.medium_on = INFINITY;
+        yaml->fan_thresholds.medium_off = INFINITY;
+    } else {
+        yaml->alarm_thresholds = first->alarm_thresholds;
+        yaml->fan_thresholds = first->fan_thresholds;
+    }
+    tempd_ext_threshold(alarm, "emergency_on",
+                        &yaml->alarm_thresholds.emergency_on);
+    tempd_ext_threshold(alarm, "emergency_off",
+                        &yaml->alarm_thresholds.emergency_off);
+    tempd_ext_threshold(alarm, "critical_on",
+                        &yaml->alarm_thresholds.critical_on);
+    tempd_ext_threshold(alarm, "critical_off",
+                        &yaml->alarm_thresholds.critical_off);
+    tempd_ext_threshold(alarm, "max_on", &yaml->alarm_thresholds.max_on);
+    tempd_ext_threshold(alarm, "max_off", &yaml->alarm_thresholds.max_off);
+    tempd_ext_threshold(alarm, "min", &yaml->alarm_thresholds.min);
+    tempd_ext_threshold(alarm, "low_crit", &yaml->alarm_thresholds.low_crit);
+    tempd_ext_threshold(fan, "max_on", &yaml->fan_thresholds.max_on);
+    tempd_ext_threshold(fan, "max_off", &yaml->fan_thresholds.max_off);
+    tempd_ext_threshold(fan, "fast_on", &yaml->fan_thresholds.fast_on);
+    tempd_ext_threshold(fan, "fast_off", &yaml->fan_thresholds.fast_off);
+    tempd_ext_threshold(fan, "medium_on", &yaml->fan_thresholds.medium_on);
+    tempd_ext_threshold(fan, "medium_off", &yaml->fan_thresholds.medium_off);
+}
+
+// create a composite sensor from its extension settings. returns NULL
+// (and leaves the definition for a later pass) if an input doesn't
+// exist yet.
+static struct locl_sensor *
+tempd_create_composite(struct locl_subsystem *subsystem, int number,
+                       const struct shash *settings)
+{
+    const struct json *inputs = shash_find_data(settings, "inputs");
+    const char *op_name = tempd_ext_get_string(settings, "op");
+    const char *location = tempd_ext_get_string(settings, "location");
+    struct locl_composite *composite;
+    struct locl_sensor *new_sensor;
+    struct locl_sensor *input;
+    YamlSensor *yaml;
+    size_t n_inputs;
+    size_t idx;
+    int window;
+
+    n_inputs = json_array(inputs)->n;
+    for (idx = 0; idx < n_inputs; idx++) {
+        const struct json *elem = json_array(inputs)->elems[idx];
+        if (elem->type != JSON_INTEGER ||
+                tempd_find_sensor(subsystem, json_integer(elem)) == NULL) {
+            return(NULL);
+        }
+    }
+
+    composite = (struct locl_composite *)malloc(sizeof(struct locl_composite));
+    memset(composite, 0, sizeof(struct locl_composite));
+    composite_op_from_string(op_name, &composite->op);
+    composite->inputs = xmalloc(n_inputs * sizeof(struct locl_sensor *));
+    composite->n_inputs = n_inputs;
+    composite->dirty = true;
+
+    for (idx = 0; idx < n_inputs; idx++) {
+        input = tempd_find_sensor(subsystem,
+                    json_integer(json_array(inputs)->elems[idx]));
+        composite->inputs[idx] = input;
+        input->dependents = xrealloc(input->dependents,
+                (input->n_dependents + 1) * sizeof(struct locl_sensor *));
+    }
+
+    yaml = xmemdup(composite->inputs[0]->yaml_sensor, sizeof(YamlSensor));
+    yaml->number = number;
+    yaml->location = xstrdup(location != NULL ? location : "");
+    yaml->device = xstrdup("");
+    yaml->type = xstrdup("composite");
+    tempd_composite_thresholds(yaml, composite, settings);
+
+    new_sensor = (struct locl_sensor *)malloc(sizeof(struct locl_sensor));
+    memset(new_sensor, 0, sizeof(struct locl_sensor));
+    new_sensor->name = xasprintf("%s-%d", subsystem->name, number);
+    new_sensor->subsystem = subsystem;
+    new_sensor->yaml_sensor = yaml;
+    new_sensor->ext = settings;
+    new_sensor->composite = composite;
+    new_sensor->min = 1000000;
+    new_sensor->max = -1000000;
+    new_sensor->status = SENSOR_STATUS_NORMAL;
+    new_sensor->fan_speed = SENSOR_FAN_NORMAL;
+    new_sensor->log.status = SENSOR_STATUS_NORMAL;
+    new_sensor->log.fan_speed = SENSOR_FAN_NORMAL;
+    new_sensor->sample_msec = -1;
+    new_sensor->published_quality = -1;
+    new_sensor->test_temp = -1;
+    new_sensor->alert_fd = -1;
+    new_sensor->state_slot = -1;
+    for (window = 0; window < STATS_N_WINDOWS; window++) {
+        stats_window_init(&new_sensor->stats[window],
+                          stats_window_span(window));
+    }
+
+    for (idx = 0; idx < n_inputs; idx++) {
+        input = composite->inputs[idx];
+        input->dependents[input->n_dependents++] = new_sensor;
+    }
+
+    return(new_sensor);
+}
+
+// create the composite sensors declared in the extension file:
+//     "composites": { "<number>": { "op": "max|min|avg|delta",
+//                                   "inputs": [ <number>, ... ],
+//                                   "location": "<text>",
+//                                   "alarm_thresholds": { ... },
+//                                   "fan_thresholds": { ... } } }
+// composites may use other composites, so definitions are resolved in
+// passes, and the order they are created in is the evaluation order.
+static void
+tempd_load_composites(struct locl_subsystem *result)
+{
+    const struct json *composites;
+    struct shash pending;
+    struct shash_node *node, *next;
+    bool progress = true;
+
+    if (result->ext == NULL) {
+        return;
+    }
+    composites = shash_find_data(json_object(result->ext), "composites");
+    if (composites == NULL || composites->type != JSON_OBJECT) {
+        return;
+    }
+
+    // validate the definitions
+    shash_init(&pending);
+    SHASH_FOR_EACH(node, json_object(composites)) {
+        const struct json *entry = node->data;
+        const struct json *inputs = NULL;
+        enum compositeop op = COMPOSITE_MAX;
+        bool op_ok = false;
+        char *end;
+        long number = strtol(node->name, &end, 10);
+
+        if (entry->type == JSON_OBJECT) {
+            inputs = shash_find_data(json_object(entry), "inputs");
+            op_ok = composite_op_from_string(
+                    tempd_ext_get_string(json_object(entry), "op"), &op);
+        }
+        if (*end != '\0' || end == node->name || !op_ok || inputs == NULL ||
+                inputs->type != JSON_ARRAY || json_array(inputs)->n == 0 ||
+                (op == COMPOSITE_DELTA && json_array(inputs)->n != 2)) {
+            VLOG_ERR("Invalid composite sensor %s in subsystem %s",
+                     node->name, result->name);
+            continue;
+        }
+        if (tempd_find_sensor(result, number) != NULL) {
+            VLOG_ERR("Composite sensor %s in subsystem %s is already a "
+                     "sensor", node->name, result->name);
+            continue;
+        }
+        shash_add(&pending, node->name, json_object(entry));
+    }
+
+    while (progress && !shash_is_empty(&pending)) {
+        progress = false;
+        SHASH_FOR_EACH_SAFE(node, next, &pending) {
+            struct locl_sensor *new_sensor;
+
+            new_sensor = tempd_create_composite(result, atoi(node->name),
+                                                node->data);
+            if (new_sensor == NULL) {
+                continue;
+            }
+
+            shash_add(&result->subsystem_sensors, new_sensor->name,
+                      (void *)new_sensor);
+            shash_add(&sensor_data, new_sensor->name, (void *)new_sensor);
+            result->composites = xrealloc(result->composites,
+                    (result->n_composites + 1) * sizeof(struct locl_sensor *));
+            result->composites[result->n_composites++] = new_sensor;
+            shash_delete(&pending, node);
+            progress = true;
+        }
+    }
+
+    // whatever is left refers to a missing sensor, or to itself
+    SHASH_FOR_EACH(node, &pending) {
+        VLOG_ERR("Composite sensor %s in subsystem %s has an unknown or "
+                 "circular input", node->name, result->name);
+    }
+    shash_destroy(&pending);
+}
+
+// create the peer groups declared in the extension file:
+//     "peer_groups": { "<name>": { "sensors": [ <number>, ... ],
+//                                  "max_spread": <degrees C> } }
+// a sensor can be in one group. composites can't be in a group (their
+// inputs are checked already).
+static void
+tempd_load_peer_groups(struct locl_subsystem *result)
+{
+    const struct json *groups;
+    struct shash_node *node;
+
+    if (result->ext == NULL) {
+        return;
+    }
+    groups = shash_find_data(json_object(result->ext), "peer_groups");
+    if (groups == NULL || groups->type != JSON_OBJECT) {
+        return;
+    }
+
+    SHASH_FOR_EACH(node, json_object(groups)) {
+        const struct json *entry = node->data;
+        const struct json *members = NULL;
+        struct locl_peergroup *group;
+        double spread;
+        size_t idx;
+
+        if (entry->type == JSON_OBJECT) {
+            members = shash_find_data(json_object(entry), "sensors");
+        }
+        if (members == NULL || members->type != JSON_ARRAY ||
+                json_array(members)->n < 2 ||
+                !tempd_ext_get_number(json_object(entry), "max_spread",
+                                      &spread)) {
+            VLOG_ERR("Invalid peer group %s in subsystem %s", node->name,
+                     result->name);
+            continue;
+        }
+
+        group = (struct locl_peergroup *)malloc(sizeof(struct locl_peergroup));
+        memset(group, 0, sizeof(struct locl_peergroup));
+        group->name = xstrdup(node->name);
+        group->max_spread = lround(spread * MILI_DEGREES);
+
+        for (idx = 0; idx < json_array(members)->n; idx++) {
+            const struct json *member = json_array(members)->elems[idx];
+            struct locl_sensor *sensor = NULL;
+
+            if (member->type == JSON_INTEGER) {
+                sensor = tempd_find_sensor(result, json_integer(member));
+            }
+            if (sensor == NULL || sensor->composite != NULL) {
+                VLOG_ERR("Peer group %s in subsystem %s has an unknown or "
+                         "composite sensor", node->name, result->name);
+            } else if (sensor->plausibility.group != NULL) {
+                VLOG_ERR("Sensor %s is in peer groups %s and %s",
+                         sensor->name, sensor->plausibility.group->name,
+                         group->name);
+            } else {
+                sensor->plausibility.group = group;
+            }
+        }
+
+        result->peer_groups = xrealloc(result->peer_groups,
+                (result->n_peer_groups + 1) * sizeof(struct locl_peergroup *));
+        result->peer_groups[result->n_peer_groups++] = group;
+    }
+}
+
+// load the hardware description for a subsystem, and create its sensors.
+// this doesn't touch the hardware or the db.
+static bool
+tempd_load_subsystem(struct locl_subsystem *result, const char *dir)
+{
+    int rc;
+    int idx;
+    int sensor_count;
+    int window;
+    const YamlThermalInfo *info;
+    const char *name = result->name;
+    struct shash_node *node;
+
+    // use a default if the hw_desc_dir has not been populated
+    if (dir == NULL || strlen(dir) == 0) {
+        VLOG_ERR("No h/w description directory for subsystem %s", name);
+        return(false);
+    }
+
+    // since this is a new subsystem, load all of the hardware description
+    // information about devices and sensors (just for this subsystem).
+    // parse sensors and device data for subsystem
+    rc = yaml_add_subsystem(yaml_handle, name, dir);
+
+    if (rc != 0) {
+        VLOG_ERR("Error reading h/w description files for subsystem %s",
+                                        name);
+        return(false);
+    }
+
+    // need devices data
+    rc = yaml_parse_devices(yaml_handle, name);
+
+    if (rc != 0) {
+        VLOG_ERR("Unable to parse subsystem %s devices file (in %s)",
+                                        name, dir);
+        return(false);
+    }
+
+    // need thermal (sensor) data
+    rc = yaml_parse_thermal(yaml_handle, name);
+
+    if (rc != 0) {
+        VLOG_ERR("Unable to parse subsystem %s thermal file (in %s)",
+                                        name, dir);
+        return(false);
+    }
+
+    // get the thermal info, need it for shutdown flag
+    info = yaml_get_thermal_info(yaml_handle, name);
+    result->emergency_shutdown = info->auto_shutdown;
+
+    // optional tempd-specific sensor settings
+    result->ext = tempd_ext_load(name, dir);
+    result->hw_desc_dir = xstrdup(dir);
 
     // OPS_TODO: the thermal info has a polling period, but when we
     // OPS_TODO: have multiple subsystems, that could be tricky to
     // OPS_TODO: implement if there are different polling periods.
     // OPS_TODO: For now, hardware the polling period to 5 seconds.
 
-    // prepare to add sensors to db
-    sensor_idx = 0;
-    sensor_count = yaml_get_sensor_count(yaml_handle, ovsrec_subsys->name);
+    sensor_count = yaml_get_sensor_count(yaml_handle, name);
+
+    if (sensor_count <= 0) {
+        return(false);
+    }
+
+    VLOG_DBG("There are %d sensors in subsystem %s", sensor_count, name);
+
+    for (idx = 0; idx < sensor_count; idx++) {
+        const YamlSensor *sensor = yaml_get_sensor(yaml_handle, name, idx);
+        char *sensor_name = NULL;
+        struct locl_sensor *new_sensor;
+        double max_rate;
+
+        VLOG_DBG("Adding sensor %d (%s) in subsystem %s",
+            sensor->number,
+            sensor->location,
+            name);
+
+        // create a name for the sensor from the subsystem name and the
+        // sensor number
+        asprintf(&sensor_name, "%s-%d", name, sensor->number);
+        // allocate and initialize basic sensor information
+        new_sensor = (struct locl_sensor *)malloc(sizeof(struct locl_sensor));
+        memset(new_sensor, 0, sizeof(struct locl_sensor));
+        new_sensor->name = sensor_name;
+        new_sensor->subsystem = result;
+        new_sensor->yaml_sensor = xmemdup(sensor, sizeof(YamlSensor));
+        new_sensor->min = 1000000;
+        new_sensor->max = -1000000;
+        new_sensor->temp = 0;
+        new_sensor->status = SENSOR_STATUS_NORMAL;
+        new_sensor->fan_speed = SENSOR_FAN_NORMAL;
+        new_sensor->log.status = SENSOR_STATUS_NORMAL;
+        new_sensor->log.fan_speed = SENSOR_FAN_NORMAL;
+        new_sensor->sample_msec = -1;
+        new_sensor->published_quality = -1;
+        new_sensor->test_temp = -1;     // no test temperature override set
+        new_sensor->alert_fd = -1;
+        new_sensor->state_slot = -1;
+        new_sensor->ext = tempd_ext_sensor(result, sensor->number);
+        // largest plausible rate of change (C per second, 0 = unchecked)
+        if (!tempd_ext_get_number(new_sensor->ext, "max_rate", &max_rate)) {
+            max_rate = PLAUSIBLE_MAX_RATE;
+        }
+        new_sensor->plausibility.max_rate = lround(max_rate * MILI_DEGREES);
+        if (strcmp(sensor->type, "lm75") == 0) {
+            lm75_settings(new_sensor);
+        }
+        new_sensor->bus = tempd_get_bus(result,
+                yaml_find_device(yaml_handle, name, sensor->device));
+        tempd_bus_add_sensor(new_sensor);
+        for (window = 0; window < STATS_N_WINDOWS; window++) {
+            stats_window_init(&new_sensor->stats[window],
+                              stats_window_span(window));
+        }
+
+        // add sensor to subsystem sensor dictionary
+        shash_add(&result->subsystem_sensors, sensor_name, (void *)new_sensor);
+        // add sensor to global sensor dictionary
+        shash_add(&sensor_data, sensor_name, (void *)new_sensor);
+    }
+
+    // virtual sensors computed from the ones above
+    tempd_load_composites(result);
+    tempd_load_peer_groups(result);
+
+    SHASH_FOR_EACH(node, &result->subsystem_sensors) {
+        tempd_duty_create((struct locl_sensor *)node->data);
+    }
+
+    result->valid = true;
+
+    return(true);
+}
+
+// create a new locl_subsystem object, and load its hardware description.
+// the sensors are not added to the db until the subsystem is published.
+static struct locl_subsystem *
+add_subsystem(const struct ovsrec_subsystem *ovsrec_subsys)
+{
+    struct locl_subsystem *result;
+
+    // create and initialize basic subsystem information
+    VLOG_DBG("Adding new subsystem %s", ovsrec_subsys->name);
+    result = (struct locl_subsystem *)malloc(sizeof(struct locl_subsystem));
+    memset(result, 0, sizeof(struct locl_subsystem));
+    (void)shash_add(&subsystem_data, ovsrec_subsys->name, (void *)result);
+    result->name = strdup(ovsrec_subsys->name);
+    result->marked = false;
+    result->marked = true;
+    result->parent_subsystem = NULL;  // OPS_TODO: find parent subsystem
+    shash_init(&result->subsystem_sensors);
+
+    if (!tempd_load_subsystem(result, ovsrec_subsys->hw_desc_dir)) {
+        return(NULL);
+    }
+
+    unpublished_subsystems = true;
+
+    return(result);
+}
+
+// restore a sensor's state from the warm-restart state file. state that
+// is too old to describe the current conditions is ignored.
+static void
+tempd_state_restore(struct locl_sensor *sensor)
+{
+    struct tempd_state_record *rec;
+
+    if (sensor->state_slot < 0) {
+        sensor->state_slot = tempd_state_slot(sensor->name);
+    }
+    rec = tempd_state_record(sensor->state_slot);
+    if (rec == NULL || rec->saved == 0 ||
+            time_wall_msec() - rec->saved > TEMPD_STATE_MAX_AGE) {
+        return;
+    }
+
+    sensor->temp = rec->temp;
+    sensor->min = rec->min;
+    sensor->max = rec->max;
+    if (rec->status < ARRAY_SIZE(sensor_status)) {
+        sensor->status = rec->status;
+    }
+    if (rec->fan_speed < ARRAY_SIZE(fan_speed)) {
+        sensor->fan_speed = rec->fan_speed;
+    }
+    sensor->fault_count = rec->fault_count;
+
+    // restored state is what's in the db, not a change
+    sensor->prev_status = sensor->status;
+    sensor->prev_fan_speed = sensor->fan_speed;
+    sensor->prev_temp = sensor->temp;
+    sensor->log.status = sensor->status;
+    sensor->log.fan_speed = sensor->fan_speed;
+    sensor->log.faulted = (sensor->fault_count > 0);
+
+    VLOG_DBG("%s: restored state (%s, fan %s)", sensor->name,
+             sensor_status_to_string(sensor->status),
+             sensor_speed_to_string(sensor->fan_speed));
+}
+
+// open or close the warm-restart state file with the ops_tempd lock: the
+// active process resizes and rewrites it, so a standby mustn't have it
+// mapped. slots are looked up again in the newly opened file.
+static void
+tempd_state_attach(bool attach)
+{
+    struct shash_node *node;
+
+    if (attach && strcmp(state_path, "none") != 0) {
+        (void)tempd_state_open(state_path);
+    } else if (!attach) {
+        tempd_state_close();
+    }
+    SHASH_FOR_EACH(node, &sensor_data) {
+        ((struct locl_sensor *)node->data)->state_slot = -1;
+    }
+}
+
+// checkpoint the state of every sensor into the warm-restart state file
+static void
+tempd_state_save(void)
+{
+    struct shash_node *node;
+    long long int now;
+
+    if (!tempd_state_is_open()) {
+        return;
+    }
+
+    now = time_wall_msec();
+    SHASH_FOR_EACH(node, &sensor_data) {
+        struct locl_sensor *sensor = (struct locl_sensor *)node->data;
+        struct tempd_state_record *rec;
+
+        if (sensor->state_slot < 0) {
+            sensor->state_slot = tempd_state_slot(sensor->name);
+        }
+        rec = tempd_state_record(sensor->state_slot);
+        if (rec == NULL) {
+            continue;
+        }
+        rec->temp = sensor->temp;
+        rec->min = sensor->min;
+        rec->max = sensor->max;
+        rec->status = sensor->status;
+        rec->fan_speed = sensor->fan_speed;
+        rec->fault_count = MIN(sensor->fault_count, UINT16_MAX);
+        rec->sampled = tempd_wall_msec(sensor->sample_msec);
+        rec->quality = sensor->quality;
+        rec->saved = now;
+    }
+    tempd_state_heartbeat(now);
+}
+
+// add a loaded subsystem's sensors to the db (requires the ops_tempd lock)
+static void
+tempd_publish_subsystem(struct locl_subsystem *result,
+                        const struct ovsrec_subsystem *ovsrec_subsys)
+{
+    struct ovsdb_idl_txn *txn;
+    struct ovsrec_temp_sensor **sensor_array;
+    struct shash_node *node;
+    int sensor_idx;
+    int sensor_count;
+    size_t idx;
+
+    // prepare to add sensors to db
+    sensor_idx = 0;
+    sensor_count = shash_count(&result->subsystem_sensors);
+
+    // subsystem db object has reference array for sensors
+    sensor_array = (struct ovsrec_temp_sensor **)malloc(sensor_count * sizeof(struct ovsrec_temp_sensor *));
+    memset(sensor_array, 0, sensor_count * sizeof(struct ovsrec_temp_sensor *));
+
+    SHASH_FOR_EACH(node, &result->subsystem_sensors) {
+        struct locl_sensor *new_sensor = (struct locl_sensor *)node->data;
+
+        // pick up the state saved by a previous ops-tempd (if any)
+        tempd_state_restore(new_sensor);
+
+        // set the resolution and conversion mode of tmp75s
+        if (strcmp(new_sensor->yaml_sensor->type, "lm75") == 0) {
+            lm75_configure(new_sensor);
+        }
+
+        // arm the hardware alert (if the sensor has one)
+        tempd_program_limits(new_sensor);
+        tempd_alert_open(new_sensor);
+
+        // try to populate sensor information with real data. a one-shot
+        // tmp75 has just been told to start its first conversion: it's
+        // read by the first poll, rather than waited for here
+        if (new_sensor->composite == NULL && !new_sensor->lm75.one_shot) {
+            tempd_read_sensor(new_sensor);
+        }
+        if (new_sensor->bus != NULL) {
+            tempd_bus_unlock(new_sensor->bus->lock);
+        }
+    }
+
+    // composites need their inputs first
+    for (idx = 0; idx < result->n_composites; idx++) {
+        tempd_read_sensor(result->composites[idx]);
+    }
+
+    txn = ovsdb_idl_txn_create(idl);
+
+    SHASH_FOR_EACH(node, &result->subsystem_sensors) {
+        struct locl_sensor *new_sensor = (struct locl_sensor *)node->data;
+        struct ovsrec_temp_sensor *ovs_sensor;
+
+        // look for existing Temp_sensor rows
+        ovs_sensor = lookup_sensor(new_sensor->name);
+
+        if (ovs_sensor == NULL) {
+            // existing sensor doesn't exist in db, create it
+            ovs_sensor = ovsrec_temp_sensor_insert(txn);
+        }
+
+        // set initial data
+        ovsrec_temp_sensor_set_name(ovs_sensor, new_sensor->name);
+        ovsrec_temp_sensor_set_status(ovs_sensor,
+            sensor_status_to_string(new_sensor->status));
+        ovsrec_temp_sensor_set_temperature(ovs_sensor, new_sensor->temp);
+        ovsrec_temp_sensor_set_min(ovs_sensor, new_sensor->min);
+        ovsrec_temp_sensor_set_max(ovs_sensor, new_sensor->max);
+        ovsrec_temp_sensor_set_fan_state(ovs_sensor,
+            sensor_speed_to_string(new_sensor->fan_speed));
+        ovsrec_temp_sensor_set_location(ovs_sensor,
+            new_sensor->yaml_sensor->location);
+
+        // add sensor to subsystem reference list
+        sensor_array[sensor_idx++] = ovs_sensor;
+    }
+
+    ovsrec_subsystem_set_temp_sensors(ovsrec_subsys, sensor_array, sensor_count);
+    // execute transaction
+    ovsdb_idl_txn_commit_block(txn);
+    ovsdb_idl_txn_destroy(txn);
+    free(sensor_array);
+
+    result->published = true;
+}
+
+// publish any subsystems that have been loaded but not yet added to the db
+// (e.g. loaded while in standby)
+static void
+tempd_publish_subsystems(void)
+{
+    const struct ovsrec_subsystem *subsys;
+
+    if (!unpublished_subsystems) {
+        return;
+    }
+
+    OVSREC_SUBSYSTEM_FOR_EACH(subsys, idl) {
+        struct locl_subsystem *subsystem;
+
+        subsystem = shash_find_data(&subsystem_data, subsys->name);
+        if (subsystem != NULL && subsystem->valid && !subsystem->published) {
+            tempd_publish_subsystem(subsystem, subsys);
+        }
+    }
+    unpublished_subsystems = false;
+}
+
+static void
+tempd_unixctl_test(struct unixctl_conn *conn, int argc OVS_UNUSED,
+                    const char *argv[], void *aud OVS_UNUSED)
+{
+    struct locl_sensor *sensor;
+    int temp;
+    const char *fan_name = argv[1];
+    struct shash_node *node;
+
+    temp = atoi(argv[2]);
+
+    // find the sensor structure
+    node = shash_find(&sensor_data, fan_name);
+    if (node == NULL) {
+        unixctl_command_reply_error(conn, "Sensor does not exist");
+        return;
+    }
+    sensor = (struct locl_sensor *)node->data;
+
+    // set the override value
+    // -1 = no override, milidegrees centigrade, otherwise
+    sensor->test_temp = temp;
+    tempd_composite_touch(sensor);
+    state_seqno++;
+    unixctl_command_reply(conn, "Test temperature override set");
+}
+
+// apply an injected temperature profile to all sensors in a subsystem, or
+// all sensors matching a name pattern
+static void
+tempd_unixctl_inject(struct unixctl_conn *conn, int argc,
+                     const char *argv[], void *aux OVS_UNUSED)
+{
+    static const int n_args[] = { 1, 2, 3, 2 };   // per injectprofile
+    const char *profile_name = argv[1];
+    const char *target = argv[2];
+    struct locl_subsystem *subsystem;
+    struct locl_inject inject;
+    struct shash_node *node;
+    bool clear = false;
+    int count = 0;
+    char *reply;
+    size_t i;
+
+    memset(&inject, 0, sizeof(inject));
+    if (strcmp(profile_name, "clear") == 0) {
+        if (argc != 3) {
+            unixctl_command_reply_error(conn, "clear takes no arguments");
+            return;
+        }
+        clear = true;
+    } else {
+        for (i = 0; i < ARRAY_SIZE(inject_profile); i++) {
+            if (strcmp(profile_name, inject_profile[i]) == 0) {
+                break;
+            }
+        }
+        if (i == ARRAY_SIZE(inject_profile)) {
+            unixctl_command_reply_error(conn, "Unknown profile");
+            return;
+        }
+        inject.profile = i;
+        if (argc != 4 + n_args[i]) {
+            unixctl_command_reply_error(conn,
+                                        "Wrong number of profile arguments");
+            return;
+        }
+        inject.start = tempd_time_msec();
+        inject.duration = atof(argv[3]) * MSEC_PER_SEC;
+        for (i = 0; i < n_args[inject.profile]; i++) {
+            inject.arg[i] = atof(argv[4 + i]);
+        }
+        inject.walk = inject.arg[0];
+        if (inject.duration <= 0 ||
+                (inject.profile == INJECT_SINE && inject.arg[2] <= 0)) {
+            unixctl_command_reply_error(conn, "Invalid profile arguments");
+            return;
+        }
+    }
+
+    subsystem = shash_find_data(&subsystem_data, target);
+
+    SHASH_FOR_EACH(node, &sensor_data) {
+        struct locl_sensor *sensor = (struct locl_sensor *)node->data;
+
+        if (subsystem != NULL ? sensor->subsystem != subsystem
+                : fnmatch(target, sensor->name, 0) != 0) {
+            continue;
+        }
+
+        free(sensor->inject);
+        sensor->inject = NULL;
+        tempd_composite_touch(sensor);
+        if (!clear) {
+            sensor->inject = xmemdup(&inject, sizeof(inject));
+        }
+        count++;
+    }
+    state_seqno++;
+
+    if (count == 0) {
+        unixctl_command_reply_error(conn, "No matching sensors");
+        return;
+    }
+
+    reply = xasprintf("%s applied to %d sensor(s)", profile_name, count);
+    unixctl_command_reply(conn, reply);
+    free(reply);
+}
+
+static unixctl_cb_func tempd_unixctl_reload;
+
+// initialize tempd process
+static void
+tempd_init(const char *remote)
+{
+    int retval;
+
+    // initialize subsystems
+    init_subsystems();
+
+    // initialize the yaml handle
+    yaml_handle = yaml_new_config_handle();
+
+    // create connection to db
+    idl = ovsdb_idl_create(remote, &ovsrec_idl_class, false, true);
+    idl_seqno = ovsdb_idl_get_seqno(idl);
+    ovsdb_idl_set_lock(idl, "ops_tempd");
+    ovsdb_idl_verify_write_only(idl);
+
+    // Register for daemon table.
+    ovsdb_idl_add_table(idl, &ovsrec_table_daemon);
+    ovsdb_idl_add_column(idl, &ovsrec_daemon_col_name);
+    ovsdb_idl_add_column(idl, &ovsrec_daemon_col_cur_hw);
+    ovsdb_idl_omit_alert(idl, &ovsrec_daemon_col_cur_hw);
+
+    ovsdb_idl_add_table(idl, &ovsrec_table_temp_sensor);
+    ovsdb_idl_add_column(idl, &ovsrec_temp_sensor_col_location);
+    ovsdb_idl_omit_alert(idl, &ovsrec_temp_sensor_col_location);
+    ovsdb_idl_add_column(idl, &ovsrec_temp_sensor_col_temperature);
+    ovsdb_idl_omit_alert(idl, &ovsrec_temp_sensor_col_temperature);
+    ovsdb_idl_add_column(idl, &ovsrec_temp_sensor_col_min);
+    ovsdb_idl_omit_alert(idl, &ovsrec_temp_sensor_col_min);
+    ovsdb_idl_add_column(idl, &ovsrec_temp_sensor_col_max);
+    ovsdb_idl_omit_alert(idl, &ovsrec_temp_sensor_col_max);
+    ovsdb_idl_add_column(idl, &ovsrec_temp_sensor_col_status);
+    ovsdb_idl_omit_alert(idl, &ovsrec_temp_sensor_col_status);
+    ovsdb_idl_add_column(idl, &ovsrec_temp_sensor_col_name);
+    ovsdb_idl_omit_alert(idl, &ovsrec_temp_sensor_col_name);
+    ovsdb_idl_add_column(idl, &ovsrec_temp_sensor_col_fan_state);
+    ovsdb_idl_omit_alert(idl, &ovsrec_temp_sensor_col_fan_state);
+    // statistics and fan duty (which sensors have a duty controller isn't
+    // known until the subsystems are loaded)
+    ovsdb_idl_add_column(idl, &ovsrec_temp_sensor_col_external_ids);
+    ovsdb_idl_omit_alert(idl, &ovsrec_temp_sensor_col_external_ids);
+
+    ovsdb_idl_add_table(idl, &ovsrec_table_subsystem);
+    ovsdb_idl_add_column(idl, &ovsrec_subsystem_col_name);
+    ovsdb_idl_add_column(idl, &ovsrec_subsystem_col_temp_sensors);
+    ovsdb_idl_omit_alert(idl, &ovsrec_subsystem_col_temp_sensors);
+    ovsdb_idl_add_column(idl, &ovsrec_subsystem_col_hw_desc_dir);
+    ovsdb_idl_omit_alert(idl, &ovsrec_subsystem_col_hw_desc_dir);
+
+    unixctl_command_register("ops-tempd/dump", "", 0, 0,
+                             tempd_unixctl_dump, NULL);
+    unixctl_command_register("ops-tempd/dump-json", "[target [fields]]", 0, 2,
+                             tempd_unixctl_dump_json, NULL);
+    unixctl_command_register("ops-tempd/test", "sensor temp", 2, 2,
+                             tempd_unixctl_test, NULL);
+    unixctl_command_register("ops-tempd/inject",
+                             "profile target [seconds args...]", 2, 6,
+                             tempd_unixctl_inject, NULL);
+    unixctl_command_register("ops-tempd/reload", "[subsystem]", 0, 1,
+                             tempd_unixctl_reload, NULL);
+
+    // the warm-restart state file is opened once we hold the lock
+    if (state_path == NULL) {
+        state_path = xasprintf("%s/ops-tempd.state", ovs_rundir());
+    }
+
+    // i2c bus locks shared with the other platform daemons
+    if (bus_lock_dir == NULL) {
+        bus_lock_dir = xstrdup(ovs_rundir());
+    } else if (strcmp(bus_lock_dir, "none") == 0) {
+        free(bus_lock_dir);
+        bus_lock_dir = NULL;
+    }
+
+    // the flight recorder is opened once we hold the lock
+    if (recorder_path == NULL) {
+        recorder_path = xasprintf("%s/ops-tempd.rec", ovs_logdir());
+    }
+
+    retval = event_log_init("TEMPERATURE");
+    if(retval < 0) {
+        VLOG_ERR("Event log initialization failed for tempareture");
+    }
+}
+
+// pre-exit shutdown processing
+static void
+tempd_exit(void)
+{
+    tempd_state_close();
+    tempd_recorder_close();
+    tempd_snapshot_unref(snapshot);
+    snapshot = NULL;
+    ovsdb_idl_destroy(idl);
+}
+
+// fields for ops-tempd/dump-json
+enum dumpfield {
+    DUMP_SUBSYSTEM = 1 << 0,
+    DUMP_LOCATION = 1 << 1,
+    DUMP_DEVICE = 1 << 2,
+    DUMP_TYPE = 1 << 3,
+    DUMP_STATUS = 1 << 4,
+    DUMP_FAN_STATE = 1 << 5,
+    DUMP_TEMPERATURE = 1 << 6,
+    DUMP_MIN = 1 << 7,
+    DUMP_MAX = 1 << 8,
+    DUMP_FAULT_COUNT = 1 << 9,
+    DUMP_BREAKER = 1 << 10,
+    DUMP_THRESHOLDS = 1 << 11,
+    DUMP_STATS = 1 << 12,
+    DUMP_SAMPLE = 1 << 13,
+    DUMP_TRANSITIONS = 1 << 14,
+    DUMP_ALL = (1 << 15) - 1
+};
+
+static const struct {
+    const char *name;
+    enum dumpfield field;
+} dump_fields[] = {
+    { "subsystem", DUMP_SUBSYSTEM },
+    { "location", DUMP_LOCATION },
+    { "device", DUMP_DEVICE },
+    { "type", DUMP_TYPE },
+    { "status", DUMP_STATUS },
+    { "fan_state", DUMP_FAN_STATE },
+    { "temperature", DUMP_TEMPERATURE },
+    { "min", DUMP_MIN },
+    { "max", DUMP_MAX },
+    { "fault_count", DUMP_FAULT_COUNT },
+    { "breaker", DUMP_BREAKER },
+    { "thresholds", DUMP_THRESHOLDS },
+    { "stats", DUMP_STATS },
+    { "sample", DUMP_SAMPLE },
+    { "transitions", DUMP_TRANSITIONS },
+};
+
+// append a json string (quoted and escaped)
+static void
+json_put_string(struct ds *ds, const char *s)
+{
+    ds_put_char(ds, '"');
+    for (; *s; s++) {
+        unsigned char c = *s;
+
+        if (c == '"' || c == '\\') {
+            ds_put_char(ds, '\\');
+            ds_put_char(ds, c);
+        } else if (c < 0x20) {
+            ds_put_format(ds, "\\u%04x", c);
+        } else {
+            ds_put_char(ds, c);
+        }
+    }
+    ds_put_char(ds, '"');
+}
+
+// append a threshold as a json member (and a comma). disabled thresholds
+// are infinite, which json can't represent: they are null.
+static void
+json_put_threshold(struct ds *ds, const char *name, double value)
+{
+    if (isfinite(value)) {
+        ds_put_format(ds, "\"%s\":%.2f,", name, value);
+    } else {
+        ds_put_format(ds, "\"%s\":null,", name);
+    }
+}
+
+// render (once) the json and support dump text for a sensor's static
+// data. thresholds and hardware information don't change while the sensor
+// exists, so this is done on first use and reused by every dump.
+static void
+tempd_sensor_render_static(struct locl_sensor *sensor)
+{
+    const YamlSensor *yaml_sensor = sensor->yaml_sensor;
+    struct ds ds = DS_EMPTY_INITIALIZER;
+
+    if (sensor->json_info == NULL) {
+        ds_put_cstr(&ds, ",\"location\":");
+        json_put_string(&ds, yaml_sensor->location);
+        ds_put_cstr(&ds, ",\"device\":");
+        json_put_string(&ds, yaml_sensor->device);
+        ds_put_cstr(&ds, ",\"type\":");
+        json_put_string(&ds, yaml_sensor->type);
+        sensor->json_info = ds_steal_cstr(&ds);
+    }
+
+    if (sensor->json_thresholds == NULL) {
+        const YamlAlarmThresholds *alarm = &yaml_sensor->alarm_thresholds;
+        const YamlFanThresholds *fan = &yaml_sensor->fan_thresholds;
+
+        ds_init(&ds);
+        ds_put_cstr(&ds, ",\"alarm_thresholds\":{");
+        json_put_threshold(&ds, "emergency_on", alarm->emergency_on);
+        json_put_threshold(&ds, "emergency_off", alarm->emergency_off);
+        json_put_threshold(&ds, "critical_on", alarm->critical_on);
+        json_put_threshold(&ds, "critical_off", alarm->critical_off);
+        json_put_threshold(&ds, "max_on", alarm->max_on);
+        json_put_threshold(&ds, "max_off", alarm->max_off);
+        json_put_threshold(&ds, "min", alarm->min);
+        json_put_threshold(&ds, "low_crit", alarm->low_crit);
+        ds_chomp(&ds, ',');
+        ds_put_cstr(&ds, "},\"fan_thresholds\":{");
+        json_put_threshold(&ds, "max_on", fan->max_on);
+        json_put_threshold(&ds, "max_off", fan->max_off);
+        json_put_threshold(&ds, "fast_on", fan->fast_on);
+        json_put_threshold(&ds, "fast_off", fan->fast_off);
+        json_put_threshold(&ds, "medium_on", fan->medium_on);
+        json_put_threshold(&ds, "medium_off", fan->medium_off);
+        ds_chomp(&ds, ',');
+        ds_put_char(&ds, '}');
+        sensor->json_thresholds = ds_steal_cstr(&ds);
+    }
+
+    if (sensor->text_info == NULL) {
+        ds_init(&ds);
+        ds_put_format(&ds, "\t\tLocation: %s\n", yaml_sensor->location);
+        ds_put_format(&ds, "\t\tDevice name: %s\n", yaml_sensor->device);
+        ds_put_format(&ds, "\t\tType: %s\n", yaml_sensor->type);
+        if (strcmp(yaml_sensor->type, "lm75") == 0) {
+            ds_put_format(&ds, "\t\tDevice: %s, %d bits, %s\n",
+                    lm75_variant_to_string(sensor->lm75.variant),
+                    sensor->lm75.resolution,
+                    sensor->lm75.one_shot ? "one-shot" : "continuous");
+        }
+        sensor->text_info = ds_steal_cstr(&ds);
+    }
+
+    if (sensor->text_config == NULL) {
+        const YamlAlarmThresholds *alarm = &yaml_sensor->alarm_thresholds;
+        const YamlFanThresholds *fan = &yaml_sensor->fan_thresholds;
+
+        ds_init(&ds);
+        if (sensor->composite != NULL) {
+            size_t idx;
+
+            ds_put_format(&ds, "\t\tComposite: %s(",
+                    composite_op_to_string(sensor->composite->op));
+            for (idx = 0; idx < sensor->composite->n_inputs; idx++) {
+                ds_put_format(&ds, "%s%s", idx ? ", " : "",
+                        sensor->composite->inputs[idx]->name);
+            }
+            ds_put_cstr(&ds, ")\n");
+        }
+        ds_put_format(&ds, "\t\tAlarm Thresholds: \n");
+        ds_put_format(&ds, "\t\t\temergency_on: %.2f\n", alarm->emergency_on);
+        ds_put_format(&ds, "\t\t\temergency_off: %.2f\n",
+                      alarm->emergency_off);
+        ds_put_format(&ds, "\t\t\tcritical_on: %.2f\n", alarm->critical_on);
+        ds_put_format(&ds, "\t\t\tcritical_off: %.2f\n", alarm->critical_off);
+        ds_put_format(&ds, "\t\t\tmax_on: %.2f\n", alarm->max_on);
+        ds_put_format(&ds, "\t\t\tmax_off: %.2f\n", alarm->max_off);
+        ds_put_format(&ds, "\t\t\tmin: %.2f\n", alarm->min);
+        ds_put_format(&ds, "\t\t\tlow_crit: %.2f\n", alarm->low_crit);
+        ds_put_format(&ds, "\t\tFan Thresholds: \n");
+        ds_put_format(&ds, "\t\t\tmax_on: %.2f\n", fan->max_on);
+        ds_put_format(&ds, "\t\t\tmax_off: %.2f\n", fan->max_off);
+        ds_put_format(&ds, "\t\t\tfast_on: %.2f\n", fan->fast_on);
+        ds_put_format(&ds, "\t\t\tfast_off: %.2f\n", fan->fast_off);
+        ds_put_format(&ds, "\t\t\tmedium_on: %.2f\n", fan->medium_on);
+        ds_put_format(&ds, "\t\t\tmedium_off: %.2f\n", fan->medium_off);
+        sensor->text_config = ds_steal_cstr(&ds);
+    }
+}
+
+// drop a sensor's cached static json (e.g. when its thresholds change)
+static void
+tempd_sensor_clear_static(struct locl_sensor *sensor)
+{
+    free(sensor->json_info);
+    sensor->json_info = NULL;
+    free(sensor->json_thresholds);
+    sensor->json_thresholds = NULL;
+    free(sensor->text_info);
+    sensor->text_info = NULL;
+    free(sensor->text_config);
+    sensor->text_config = NULL;
+}
+
+static size_t
+tempd_snapshot_string(struct ds *strings, const char *s)
+{
+    size_t offset = strings->length;
+
+    ds_put_cstr(strings, s);
+    ds_put_char(strings, '\0');
+    return(offset);
+}
+
+// copy the state of every sensor (in dump order) into a new snapshot
+static struct tempd_snapshot *
+tempd_snapshot_take(void)
+{
+    struct ds strings = DS_EMPTY_INITIALIZER;
+    struct ds text = DS_EMPTY_INITIALIZER;
+    struct tempd_snapshot *snap;
+    struct shash_node *snode;
+    struct shash_node *tnode;
+    long long int now = tempd_time_msec();
+    size_t n_sensors = 0;
+    int window;
+
+    SHASH_FOR_EACH(snode, &subsystem_data) {
+        struct locl_subsystem *subsystem = (struct locl_subsystem *)snode->data;
+
+        n_sensors += shash_count(&subsystem->subsystem_sensors);
+    }
+
+    snap = (struct tempd_snapshot *)xmalloc(sizeof(struct tempd_snapshot));
+    memset(snap, 0, sizeof(struct tempd_snapshot));
+    ovs_refcount_init(&snap->ref_cnt);
+    snap->seqno = state_seqno;
+    snap->msec = now;
+    snap->heartbeat = tempd_wall_msec(last_poll_msec);
+    smap_init(&snap->replies);
+    snap->sensors = xmalloc(MAX(n_sensors, 1) * sizeof(*snap->sensors));
+    memset(snap->sensors, 0, MAX(n_sensors, 1) * sizeof(*snap->sensors));
+
+    // the daemon's own state is small: its text is rendered right away
+    tempd_dump_header(&text);
+    snap->text_header = tempd_snapshot_string(&strings, ds_cstr(&text));
+    ds_clear(&text);
+    tempd_dump_buses(&text);
+    snap->text_buses = tempd_snapshot_string(&strings, ds_cstr(&text));
+    ds_destroy(&text);
+
+    SHASH_FOR_EACH(snode, &subsystem_data) {
+        struct locl_subsystem *subsystem = (struct locl_subsystem *)snode->data;
+
+        SHASH_FOR_EACH(tnode, &(subsystem->subsystem_sensors)) {
+            struct locl_sensor *sensor = (struct locl_sensor *)tnode->data;
+            struct snapshot_sensor *copy = &snap->sensors[snap->n_sensors++];
+
+            tempd_sensor_render_static(sensor);
+            copy->name = tempd_snapshot_string(&strings, sensor->name);
+            copy->subsystem = tempd_snapshot_string(&strings,
+                                                    subsystem->name);
+            copy->location = tempd_snapshot_string(&strings,
+                                            sensor->yaml_sensor->location);
+            copy->device = tempd_snapshot_string(&strings,
+                                            sensor->yaml_sensor->device);
+            copy->type = tempd_snapshot_string(&strings,
+                                            sensor->yaml_sensor->type);
+            copy->json_info = tempd_snapshot_string(&strings,
+                                                    sensor->json_info);
+            copy->json_thresholds = tempd_snapshot_string(&strings,
+                                                    sensor->json_thresholds);
+            copy->text_info = tempd_snapshot_string(&strings,
+                                                    sensor->text_info);
+            copy->text_config = tempd_snapshot_string(&strings,
+                                                      sensor->text_config);
+            copy->status = sensor->status;
+            copy->fan_speed = sensor->fan_speed;
+            copy->has_duty = (sensor->duty != NULL);
+            if (copy->has_duty) {
+                copy->duty = sensor->duty->duty;
+                copy->duty_mode = sensor->duty->mode;
+                copy->duty_slope = sensor->duty->slope;
+                copy->duty_published = sensor->duty->published;
+            }
+            copy->temp = sensor->temp;
+            copy->min = sensor->min;
+            copy->max = sensor->max;
+            copy->fault_count = sensor->fault_count;
+            copy->logged = sensor->log.logged;
+            copy->suppressed = sensor->log.suppressed;
+            copy->quality = sensor->quality;
+            copy->sampled = tempd_wall_msec(sensor->sample_msec);
+            copy->implausible = sensor->plausibility.rejected;
+            copy->composite = (sensor->composite != NULL);
+            copy->max_rate = sensor->plausibility.max_rate;
+            copy->peers = tempd_snapshot_string(&strings,
+                    sensor->plausibility.group != NULL ?
+                        sensor->plausibility.group->name : "none");
+            copy->alert = (sensor->alert_fd >= 0);
+            copy->breaker = sensor->breaker;
+            copy->read_msec = sensor->read_msec;
+            for (window = 0; window < STATS_N_WINDOWS; window++) {
+                stats_window_get(&sensor->stats[window], now,
+                                 &copy->stats[window]);
+            }
+            copy->injected = (sensor->inject != NULL);
+            if (copy->injected) {
+                copy->inject_profile = sensor->inject->profile;
+                copy->inject_until = tempd_wall_msec(sensor->inject->start +
+                                                     sensor->inject->duration);
+            }
+        }
+    }
+
+    snap->strings = ds_steal_cstr(&strings);
+    return(snap);
+}
+
+// drop a reference to a snapshot, freeing it with the last one
+static void
+tempd_snapshot_unref(struct tempd_snapshot *snap)
+{
+    if (snap != NULL && ovs_refcount_unref(&snap->ref_cnt) == 1) {
+        smap_destroy(&snap->replies);
+        free(snap->strings);
+        free(snap->sensors);
+        free(snap);
+    }
+}
+
+// get (a reference to) a snapshot of the current state. a new snapshot is
+// only taken if the state changed since the last one; the previous one is
+// freed once nothing uses it any more.
+static struct tempd_snapshot *
+tempd_snapshot_get(void)
+{
+    if (snapshot == NULL || snapshot->seqno != state_seqno) {
+        struct tempd_snapshot *old = snapshot;
+
+        snapshot = tempd_snapshot_take();
+        tempd_snapshot_unref(old);
+    }
+    ovs_refcount_ref(&snapshot->ref_cnt);
+    return(snapshot);
+}
+
+// keep a rendered reply with the snapshot it was rendered from
+static void
+tempd_snapshot_cache(struct tempd_snapshot *snap, const char *key,
+                     const char *reply)
+{
+    if (smap_count(&snap->replies) < SNAPSHOT_MAX_REPLIES) {
+        smap_add(&snap->replies, key, reply);
+    }
+}
+
+// log the result of a sensor read to the flight recorder
+static void
+tempd_record_read(struct locl_sensor *sensor)
+{
+    if (!tempd_recorder_is_open()) {
+        return;
+    }
+    if (sensor->recorder_id == 0) {
+        sensor->recorder_id = tempd_recorder_sensor(sensor->name);
+    }
+    if (sensor->fault_count > 0) {
+        tempd_recorder_fault(sensor->recorder_id);
+    } else {
+        tempd_recorder_temp(sensor->recorder_id, sensor->temp);
+    }
+}
+
+// is a sensor in a state that's logged as a warning?
+static bool
+tempd_sensor_log_warn(const struct locl_sensor *sensor)
+{
+    return(sensor->status == SENSOR_STATUS_LOWCRIT ||
+           sensor->status == SENSOR_STATUS_CRITICAL ||
+           sensor->status == SENSOR_STATUS_FAILED ||
+           sensor->status == SENSOR_STATUS_EMERGENCY);
+}
+
+// log a sensor's status, fan speed or read failure transition (if any).
+// called for every sensor on every poll, so the no-change case is only a
+// few compares, and nothing is formatted unless the level is enabled.
+// warnings are always logged; other transitions are rate limited, and a
+// period that ends with some of them not logged ends with a summary.
+static void
+tempd_sensor_log(struct locl_sensor *sensor)
+{
+    struct locl_sensorlog *log = &sensor->log;
+    bool faulted = (sensor->fault_count > 0);
+    long long int now = tempd_time_msec();
+    bool warn;
+
+    if (now - log->period_start >= SENSORLOG_PERIOD * MSEC_PER_SEC) {
+        if (log->unreported > 0) {
+            warn = tempd_sensor_log_warn(sensor);
+            if (warn ? VLOG_IS_WARN_ENABLED() : VLOG_IS_INFO_ENABLED()) {
+                char *msg = xasprintf("%s: %u transitions not logged in the "
+                                      "last %d s, now status %s, fan %s, "
+                                      "%.1f C", sensor->name,
+                                      log->unreported, SENSORLOG_PERIOD,
+                                      sensor_status_to_string(log->status),
+                                      sensor_speed_to_string(log->fan_speed),
+                                      sensor->temp / MILI_DEGREES_FLOAT);
+                if (warn) {
+                    VLOG_WARN("%s", msg);
+                } else {
+                    VLOG_INFO("%s", msg);
+                }
+                free(msg);
+            }
+            log->unreported = 0;
+        }
+        log->period_start = now;
+        log->period_count = 0;
+    }
+
+    if (sensor->status == log->status && sensor->fan_speed == log->fan_speed &&
+            faulted == log->faulted) {
+        return;
+    }
+
+    warn = (faulted && !log->faulted) || tempd_sensor_log_warn(sensor);
+    if (!warn && log->period_count >= SENSORLOG_BURST) {
+        log->suppressed++;
+        log->unreported++;
+    } else {
+        if (warn ? VLOG_IS_WARN_ENABLED() : VLOG_IS_INFO_ENABLED()) {
+            struct ds ds = DS_EMPTY_INITIALIZER;
+
+            ds_put_format(&ds, "%s:", sensor->name);
+            if (sensor->status != log->status) {
+                ds_put_format(&ds, " status %s -> %s,",
+                              sensor_status_to_string(log->status),
+                              sensor_status_to_string(sensor->status));
+            }
+            if (sensor->fan_speed != log->fan_speed) {
+                ds_put_format(&ds, " fan %s -> %s,",
+                              sensor_speed_to_string(log->fan_speed),
+                              sensor_speed_to_string(sensor->fan_speed));
+            }
+            if (faulted != log->faulted) {
+                ds_put_format(&ds, " read %s,",
+                              faulted ? "failing" : "recovered");
+            }
+            ds_put_format(&ds, " %.1f C", sensor->temp / MILI_DEGREES_FLOAT);
+            if (log->unreported > 0) {
+                ds_put_format(&ds, " (%u earlier transitions not logged)",
+                              log->unreported);
+            }
+            if (warn) {
+                VLOG_WARN("%s", ds_cstr(&ds));
+            } else {
+                VLOG_INFO("%s", ds_cstr(&ds));
+            }
+            ds_destroy(&ds);
+        }
+        log->period_count++;
+        log->logged++;
+        log->unreported = 0;
+    }
+
+    log->status = sensor->status;
+    log->fan_speed = sensor->fan_speed;
+    log->faulted = faulted;
+}
+
+// add a sensor's current temperature to its rolling statistics. this is
+// done once per poll (not per read), and only by the process that owns
+// the sensors: shadow reads in standby don't count.
+static void
+tempd_sensor_stats(struct locl_sensor *sensor)
+{
+    int window;
+
+    if ((!active && virtual_msec < 0) ||
+            sensor->status == SENSOR_STATUS_FAILED) {
+        return;
+    }
+    for (window = 0; window < STATS_N_WINDOWS; window++) {
+        stats_window_add(&sensor->stats[window], tempd_time_msec(),
+                         sensor->temp);
+    }
+}
+
+// read one sensor. returns true if the sensor requires an emergency
+// shutdown.
+static bool
+tempd_poll_sensor(struct locl_sensor *sensor)
+{
+    int temp = sensor->temp;
+    enum sensorstatus status = sensor->status;
+    enum fanspeed speed = sensor->fan_speed;
+    bool shutdown = false;
+
+    if (sensor->composite != NULL) {
+        sensor->composite->dirty = false;
+    }
+
+    tempd_read_sensor(sensor);
+    tempd_record_read(sensor);
+    if (sensor->status == SENSOR_STATUS_EMERGENCY) {
+        // if we're in an emergency situation, verify that the sensor
+        // was read correctly (by reading it again).
+        tempd_read_sensor(sensor);
+        tempd_record_read(sensor);
+        shutdown = (sensor->status == SENSOR_STATUS_EMERGENCY &&
+                    sensor->subsystem->emergency_shutdown == true);
+    }
+    tempd_sensor_stats(sensor);
+
+    if (sensor->status != status || sensor->fan_speed != speed) {
+        tempd_recorder_state(sensor->recorder_id, sensor->status,
+                             sensor->fan_speed);
+    }
+    // shadow reads in standby aren't logged: the active process logs
+    if (active || virtual_msec >= 0) {
+        tempd_sensor_log(sensor);
+    }
+    if (shutdown) {
+        return(true);
+    }
+
+    tempd_mark_dependents(sensor, temp, status);
+    return(false);
+}
+
+// is a sensor's value simulated (a test override, an injection or a
+// trace), or computed from a simulated input?
+static bool
+tempd_sensor_simulated(const struct locl_sensor *sensor)
+{
+    size_t idx;
 
-    if (sensor_count <= 0) {
-        return(NULL);
+    if (sensor->test_temp != -1 || sensor->inject != NULL ||
+            sensor->trace != NULL) {
+        return(true);
+    }
+    if (sensor->composite != NULL) {
+        for (idx = 0; idx < sensor->composite->n_inputs; idx++) {
+            if (tempd_sensor_simulated(sensor->composite->inputs[idx])) {
+                return(true);
+            }
+        }
     }
+    return(false);
+}
 
-    result->valid = true;
+// poll one sensor, and note it if it requires an emergency shutdown. an
+// emergency from a simulated temperature (outside of a replay) is only
+// logged and counted: a test or an injection mustn't power off the switch,
+// nor hide a real emergency on another sensor.
+static void
+tempd_poll_emergency(struct locl_sensor *sensor,
+                     struct locl_sensor **emergency)
+{
+    if (!tempd_poll_sensor(sensor)) {
+        return;
+    }
+    if (virtual_msec < 0 && !simulated_shutdown &&
+            tempd_sensor_simulated(sensor)) {
+        simulated_emergencies++;
+        VLOG_WARN_RL(&simulated_rl, "%s: emergency from a simulated "
+                     "temperature, not shutting down (see "
+                     "--simulated-shutdown)", sensor->name);
+        return;
+    }
+    if (*emergency == NULL) {
+        *emergency = sensor;
+    }
+}
 
-    // subsystem db object has reference array for sensors
-    sensor_array = (struct ovsrec_temp_sensor **)malloc(sensor_count * sizeof(struct ovsrec_temp_sensor *));
-    memset(sensor_array, 0, sensor_count * sizeof(struct ovsrec_temp_sensor *));
+// read every sensor. returns the first sensor that requires an emergency
+// shutdown (if any). every sensor is read even then, so that a sensor
+// that doesn't shut the system down (a simulated one) can't keep the
+// others from being read, and replayed traces all keep advancing.
+static struct locl_sensor *
+tempd_poll_sensors(void)
+{
+    struct shash_node *node;
+    struct shash_node *sensor_node;
+    struct locl_sensor *sensor;
+    struct locl_sensor *emergency = NULL;
+    size_t bidx;
+    size_t idx;
 
-    txn = ovsdb_idl_txn_create(idl);
+    state_seqno++;
+    last_poll_msec = tempd_time_msec();
+    polls++;
+    tempd_recorder_time(last_poll_msec);
 
-    VLOG_DBG("There are %d sensors in subsystem %s", sensor_count, ovsrec_subsys->name);
+    // sensors on i2c buses, one shared bus lock at a time: the transfers
+    // on all the buses behind a lock are done in one window, bus by bus
+    SHASH_FOR_EACH(node, &buslock_data) {
+        struct locl_buslock *lock = (struct locl_buslock *)node->data;
 
-    for (idx = 0; idx < sensor_count; idx++) {
-        const YamlSensor *sensor = yaml_get_sensor(yaml_handle, ovsrec_subsys->name, idx);
+        for (bidx = 0; bidx < lock->n_buses; bidx++) {
+            struct locl_bus *bus = lock->buses[bidx];
 
-        struct ovsrec_temp_sensor *ovs_sensor;
-        char *sensor_name = NULL;
-        struct locl_sensor *new_sensor;
-        VLOG_DBG("Adding sensor %d (%s) in subsystem %s",
-            sensor->number,
-            sensor->location,
-            ovsrec_subsys->name);
+            for (idx = 0; idx < bus->n_sensors; idx++) {
+                tempd_poll_emergency(bus->sensors[idx], &emergency);
+            }
+        }
+        tempd_bus_unlock(lock);
+    }
 
-        // create a name for the sensor from the subsystem name and the
-        // sensor number
-        asprintf(&sensor_name, "%s-%d", ovsrec_subsys->name, sensor->number);
-        // allocate and initialize basic sensor information
-        new_sensor = (struct locl_sensor *)malloc(sizeof(struct locl_sensor));
-        new_sensor->name = sensor_name;
-        new_sensor->subsystem = result;
-        new_sensor->yaml_sensor = sensor;
-        new_sensor->min = 1000000;
-        new_sensor->max = -1000000;
-        new_sensor->temp = 0;
-        new_sensor->status = SENSOR_STATUS_NORMAL;
-        new_sensor->fan_speed = SENSOR_FAN_NORMAL;
-        new_sensor->test_temp = -1;     // no test temperature override set
+    SHASH_FOR_EACH(node, &subsystem_data) {
+        struct locl_subsystem *subsystem = (struct locl_subsystem *)node->data;
+        SHASH_FOR_EACH(sensor_node, &subsystem->subsystem_sensors) {
+            sensor = (struct locl_sensor *)sensor_node->data;
+            if (sensor->composite != NULL || sensor->bus != NULL) {
+                // composites are evaluated below, once their inputs have
+                // been read (sensors on a bus have been read above)
+                continue;
+            }
+            tempd_poll_emergency(sensor, &emergency);
+        }
+        // only re-evaluate composites whose inputs changed
+        for (idx = 0; idx < subsystem->n_composites; idx++) {
+            sensor = subsystem->composites[idx];
+            if (!sensor->composite->dirty && sensor->inject == NULL) {
+                // unchanged, but still sampled every poll
+                tempd_sensor_stats(sensor);
+                continue;
+            }
+            tempd_poll_emergency(sensor, &emergency);
+        }
+    }
 
-        // try to populate sensor information with real data
-        tempd_read_sensor(new_sensor);
+    return(emergency);
+}
 
-        // add sensor to subsystem sensor dictionary
-        shash_add(&result->subsystem_sensors, sensor_name, (void *)new_sensor);
-        // add sensor to global sensor dictionary
-        shash_add(&sensor_data, sensor_name, (void *)new_sensor);
+// open the change event socket. only the process holding the ops_tempd
+// lock listens: a standby would take over (and, on exit, unlink) the
+// active process's socket path.
+static void
+tempd_events_open(void)
+{
+    int retval;
 
-        // look for existing Temp_sensor rows
-        ovs_sensor = lookup_sensor(sensor_name);
+    if (events_path == NULL) {
+        events_path = xasprintf("punix:%s/ops-tempd.events", ovs_rundir());
+    } else if (strcmp(events_path, "none") == 0) {
+        return;
+    }
 
-        if (ovs_sensor == NULL) {
-            // existing sensor doesn't exist in db, create it
-            ovs_sensor = ovsrec_temp_sensor_insert(txn);
-        }
+    retval = pstream_open(events_path, &events_listener, DSCP_DEFAULT);
+    if (retval) {
+        VLOG_ERR("Unable to open events socket %s (%s)", events_path,
+                 ovs_strerror(retval));
+        events_listener = NULL;
+    }
+}
 
-        // set initial data
-        ovsrec_temp_sensor_set_name(ovs_sensor, sensor_name);
-        ovsrec_temp_sensor_set_status(ovs_sensor,
-            sensor_status_to_string(new_sensor->status));
-        ovsrec_temp_sensor_set_temperature(ovs_sensor, new_sensor->temp);
-        ovsrec_temp_sensor_set_min(ovs_sensor, new_sensor->min);
-        ovsrec_temp_sensor_set_max(ovs_sensor, new_sensor->max);
-        ovsrec_temp_sensor_set_fan_state(ovs_sensor,
-            sensor_speed_to_string(new_sensor->fan_speed));
-        ovsrec_temp_sensor_set_location(ovs_sensor, sensor->location);
+static void
+tempd_subscriber_destroy(size_t idx)
+{
+    struct locl_subscriber *sub = subscribers[idx];
 
-        // add sensor to subsystem reference list
-        sensor_array[sensor_idx++] = ovs_sensor;
+    stream_close(sub->stream);
+    simap_destroy(&sub->sent_temp);
+    sset_destroy(&sub->pending);
+    ds_destroy(&sub->out);
+    ds_destroy(&sub->in);
+    free(sub->filter);
+    free(sub);
+
+    subscribers[idx] = subscribers[--n_subscribers];
+}
+
+// close the change event socket, and disconnect its subscribers (when the
+// ops_tempd lock is lost, or on exit)
+static void
+tempd_events_close(void)
+{
+    while (n_subscribers > 0) {
+        tempd_subscriber_destroy(n_subscribers - 1);
     }
+    pstream_close(events_listener);
+    events_listener = NULL;
+}
 
-    ovsrec_subsystem_set_temp_sensors(ovsrec_subsys, sensor_array, sensor_count);
-    // execute transaction
-    ovsdb_idl_txn_commit_block(txn);
-    ovsdb_idl_txn_destroy(txn);
-    free(sensor_array);
+// handle a command line from a subscriber
+static void
+tempd_subscriber_command(struct locl_subscriber *sub, const char *line)
+{
+    char arg[128];
+    int deadband;
+
+    if (sscanf(line, "deadband %d", &deadband) == 1 && deadband >= 0) {
+        sub->deadband = deadband;
+    } else if (sscanf(line, "filter %127s", arg) == 1) {
+        free(sub->filter);
+        sub->filter = strcmp(arg, "*") ? xstrdup(arg) : NULL;
+    } else if (line[0] != '\0') {
+        ds_put_cstr(&sub->out, "{\"error\":\"unknown command\"}\n");
+    }
+}
 
-    return(result);
+// queue a change event for a sensor, for every interested subscriber.
+// only the sensor name is queued; the event is rendered from the current
+// state when it is sent, so a slow subscriber gets the latest values
+// instead of a backlog.
+static void
+tempd_events_notify(const struct locl_sensor *sensor, bool state_changed)
+{
+    size_t i;
+
+    for (i = 0; i < n_subscribers; i++) {
+        struct locl_subscriber *sub = subscribers[i];
+
+        if (sub->filter != NULL && fnmatch(sub->filter, sensor->name, 0)) {
+            continue;
+        }
+        if (!state_changed) {
+            const struct simap_node *last;
+
+            last = simap_find(&sub->sent_temp, sensor->name);
+            if (last != NULL &&
+                    abs((int)last->data - sensor->temp) < sub->deadband) {
+                continue;
+            }
+        }
+        if (!sset_add(&sub->pending, sensor->name)) {
+            sub->dropped++;
+        }
+    }
 }
 
+// compute the set of sensors that changed since the previous poll, and
+// queue events for them
 static void
-tempd_unixctl_test(struct unixctl_conn *conn, int argc OVS_UNUSED,
-                    const char *argv[], void *aud OVS_UNUSED)
+tempd_events_collect(void)
 {
-    struct locl_sensor *sensor;
-    int temp;
-    const char *fan_name = argv[1];
     struct shash_node *node;
 
-    temp = atoi(argv[2]);
+    SHASH_FOR_EACH(node, &sensor_data) {
+        struct locl_sensor *sensor = (struct locl_sensor *)node->data;
+        bool state_changed = sensor->status != sensor->prev_status ||
+                             sensor->fan_speed != sensor->prev_fan_speed;
 
-    // find the sensor structure
-    node = shash_find(&sensor_data, fan_name);
-    if (node == NULL) {
-        unixctl_command_reply_error(conn, "Sensor does not exist");
+        if (state_changed || sensor->temp != sensor->prev_temp) {
+            if (n_subscribers > 0) {
+                tempd_events_notify(sensor, state_changed);
+            }
+            sensor->prev_status = sensor->status;
+            sensor->prev_fan_speed = sensor->fan_speed;
+            sensor->prev_temp = sensor->temp;
+        }
+    }
+}
+
+// render queued events for a subscriber (while there's buffer space)
+static void
+tempd_subscriber_render(struct locl_subscriber *sub)
+{
+    const char **names;
+    size_t n;
+    size_t i;
+
+    if (sset_is_empty(&sub->pending) || sub->out.length >= SUBSCRIBER_MAX_OUT) {
         return;
     }
-    sensor = (struct locl_sensor *)node->data;
 
-    // set the override value
-    // -1 = no override, milidegrees centigrade, otherwise
-    sensor->test_temp = temp;
-    unixctl_command_reply(conn, "Test temperature override set");
+    names = sset_array(&sub->pending);
+    n = sset_count(&sub->pending);
+    for (i = 0; i < n; i++) {
+        struct locl_sensor *sensor = shash_find_data(&sensor_data, names[i]);
+
+        if (sensor == NULL) {
+            continue;
+        }
+        ds_put_cstr(&sub->out, "{\"sensor\":");
+        json_put_string(&sub->out, sensor->name);
+        ds_put_format(&sub->out, ",\"status\":\"%s\",\"fan_state\":\"%s\","
+                      "\"temperature\":%d}\n",
+                      sensor_status_to_string(sensor->status),
+                      sensor_speed_to_string(sensor->fan_speed),
+                      sensor->temp);
+        simap_put(&sub->sent_temp, sensor->name, (unsigned int)sensor->temp);
+    }
+    free(names);
+    sset_clear(&sub->pending);
 }
 
-// initialize tempd process
+// accept new subscribers, read their commands and send their events
 static void
-tempd_init(const char *remote)
+tempd_events_run(void)
 {
-    int retval;
+    struct shash_node *node;
+    struct stream *stream;
+    size_t i;
+
+    while (events_listener != NULL &&
+            pstream_accept(events_listener, &stream) == 0) {
+        struct locl_subscriber *sub = xzalloc(sizeof *sub);
+
+        sub->stream = stream;
+        simap_init(&sub->sent_temp);
+        sset_init(&sub->pending);
+        ds_init(&sub->out);
+        ds_init(&sub->in);
+        subscribers = xrealloc(subscribers,
+                               (n_subscribers + 1) * sizeof *subscribers);
+        subscribers[n_subscribers++] = sub;
+        VLOG_DBG("events: new subscriber");
+
+        // start with the current state of every sensor
+        SHASH_FOR_EACH(node, &sensor_data) {
+            sset_add(&sub->pending, node->name);
+        }
+    }
 
-    // initialize subsystems
-    init_subsystems();
+    for (i = 0; i < n_subscribers; ) {
+        struct locl_subscriber *sub = subscribers[i];
+        char buf[128];
+        int retval;
 
-    // initialize the yaml handle
-    yaml_handle = yaml_new_config_handle();
+        stream_run(sub->stream);
 
-    // create connection to db
-    idl = ovsdb_idl_create(remote, &ovsrec_idl_class, false, true);
-    idl_seqno = ovsdb_idl_get_seqno(idl);
-    ovsdb_idl_set_lock(idl, "ops_tempd");
-    ovsdb_idl_verify_write_only(idl);
+        // commands from the client
+        while ((retval = stream_recv(sub->stream, buf, sizeof buf)) > 0) {
+            char *nl;
 
-    // Register for daemon table.
-    ovsdb_idl_add_table(idl, &ovsrec_table_daemon);
-    ovsdb_idl_add_column(idl, &ovsrec_daemon_col_name);
-    ovsdb_idl_add_column(idl, &ovsrec_daemon_col_cur_hw);
-    ovsdb_idl_omit_alert(idl, &ovsrec_daemon_col_cur_hw);
+            ds_put_buffer(&sub->in, buf, retval);
+            while ((nl = memchr(sub->in.string, '\n', sub->in.length))) {
+                size_t len = nl - sub->in.string + 1;
 
-    ovsdb_idl_add_table(idl, &ovsrec_table_temp_sensor);
-    ovsdb_idl_add_column(idl, &ovsrec_temp_sensor_col_location);
-    ovsdb_idl_omit_alert(idl, &ovsrec_temp_sensor_col_location);
-    ovsdb_idl_add_column(idl, &ovsrec_temp_sensor_col_temperature);
-    ovsdb_idl_omit_alert(idl, &ovsrec_temp_sensor_col_temperature);
-    ovsdb_idl_add_column(idl, &ovsrec_temp_sensor_col_min);
-    ovsdb_idl_omit_alert(idl, &ovsrec_temp_sensor_col_min);
-    ovsdb_idl_add_column(idl, &ovsrec_temp_sensor_col_max);
-    ovsdb_idl_omit_alert(idl, &ovsrec_temp_sensor_col_max);
-    ovsdb_idl_add_column(idl, &ovsrec_temp_sensor_col_status);
-    ovsdb_idl_omit_alert(idl, &ovsrec_temp_sensor_col_status);
-    ovsdb_idl_add_column(idl, &ovsrec_temp_sensor_col_name);
-    ovsdb_idl_omit_alert(idl, &ovsrec_temp_sensor_col_name);
-    ovsdb_idl_add_column(idl, &ovsrec_temp_sensor_col_fan_state);
-    ovsdb_idl_omit_alert(idl, &ovsrec_temp_sensor_col_fan_state);
+                *nl = '\0';
+                tempd_subscriber_command(sub, sub->in.string);
+                memmove(sub->in.string, nl + 1, sub->in.length - len);
+                sub->in.length -= len;
+            }
+            if (sub->in.length > sizeof buf) {
+                ds_clear(&sub->in);
+            }
+        }
+        if (retval == 0 || (retval < 0 && retval != -EAGAIN)) {
+            tempd_subscriber_destroy(i);
+            continue;
+        }
 
-    ovsdb_idl_add_table(idl, &ovsrec_table_subsystem);
-    ovsdb_idl_add_column(idl, &ovsrec_subsystem_col_name);
-    ovsdb_idl_add_column(idl, &ovsrec_subsystem_col_temp_sensors);
-    ovsdb_idl_omit_alert(idl, &ovsrec_subsystem_col_temp_sensors);
-    ovsdb_idl_add_column(idl, &ovsrec_subsystem_col_hw_desc_dir);
-    ovsdb_idl_omit_alert(idl, &ovsrec_subsystem_col_hw_desc_dir);
+        // events to the client
+        tempd_subscriber_render(sub);
+        if (sub->out.length > 0) {
+            retval = stream_send(sub->stream, sub->out.string,
+                                 sub->out.length);
+            if (retval > 0) {
+                memmove(sub->out.string, sub->out.string + retval,
+                        sub->out.length - retval);
+                sub->out.length -= retval;
+            } else if (retval != -EAGAIN) {
+                tempd_subscriber_destroy(i);
+                continue;
+            }
+        }
+        i++;
+    }
+}
 
-    unixctl_command_register("ops-tempd/dump", "", 0, 0,
-                             tempd_unixctl_dump, NULL);
-    unixctl_command_register("ops-tempd/test", "sensor temp", 2, 2,
-                             tempd_unixctl_test, NULL);
+static void
+tempd_events_wait(void)
+{
+    size_t i;
 
-    retval = event_log_init("TEMPERATURE");
-    if(retval < 0) {
-        VLOG_ERR("Event log initialization failed for tempareture");
+    if (events_listener != NULL) {
+        pstream_wait(events_listener);
+    }
+    for (i = 0; i < n_subscribers; i++) {
+        struct locl_subscriber *sub = subscribers[i];
+
+        stream_run_wait(sub->stream);
+        stream_recv_wait(sub->stream);
+        if (sub->out.length > 0) {
+            stream_send_wait(sub->stream);
+        } else if (!sset_is_empty(&sub->pending)) {
+            poll_immediate_wake();
+        }
+    }
+}
+
+// write a sensor's rolling statistics (if stats is set) as "min,avg,max"
+// (milidegrees) per window, its sample time and read quality (if samples
+// is set), and its fan duty request (if it has one), into the external_ids
+// of its row
+static void
+tempd_publish_external_ids(struct locl_sensor *sensor,
+                           const struct ovsrec_temp_sensor *cfg, bool stats,
+                           bool samples)
+{
+    struct smap external_ids;
+    int window;
+
+    smap_clone(&external_ids, &cfg->external_ids);
+    if (samples) {
+        char *value;
+
+        sensor->published_quality = sensor->quality;
+        smap_replace(&external_ids, "sample_quality",
+                     read_quality_to_string(sensor->quality));
+        value = xasprintf("%lld", tempd_wall_msec(sensor->sample_msec));
+        smap_replace(&external_ids, "sample_time", value);
+        free(value);
+    }
+    if (sensor->duty != NULL) {
+        char *value;
+
+        sensor->duty->published = lround(sensor->duty->duty);
+        value = xasprintf("%d", sensor->duty->published);
+        smap_replace(&external_ids, "fan_duty", value);
+        free(value);
+    }
+    for (window = 0; stats && window < STATS_N_WINDOWS; window++) {
+        struct stats_result result;
+        char *key;
+
+        key = xasprintf("stats_%s", stats_window_name(window));
+        if (stats_window_get(&sensor->stats[window], tempd_time_msec(),
+                             &result)) {
+            char *value = xasprintf("%d,%d,%d", result.min, result.avg,
+                                    result.max);
+            smap_replace(&external_ids, key, value);
+            free(value);
+        }
+        free(key);
+    }
+    ovsrec_temp_sensor_set_external_ids(cfg, &external_ids);
+    smap_destroy(&external_ids);
+}
+
+// map shutdownstage enum to the equivalent string
+static const char *
+shutdown_stage_to_string(enum shutdownstage stage)
+{
+    if (stage < sizeof(shutdown_stage)/sizeof(const char *)) {
+        return(shutdown_stage[stage]);
+    } else {
+        return("unknown");
+    }
+}
+
+// shutdown stage: get everything that explains the shutdown onto disk
+static int
+tempd_shutdown_record(struct locl_sensor *sensor)
+{
+    VLOG_WARN("Emergency shutdown initiated for sensor %s", sensor->name);
+    log_event("TEMP_SENSOR_SHUTDOWN",
+        EV_KV("name", "%s", sensor->name));
+
+    tempd_recorder_shutdown(sensor->recorder_id);
+    tempd_recorder_flush(true);
+    tempd_state_save();
+    tempd_state_sync();
+    return(0);
+}
+
+// shutdown stage: write the sensor's status to the db (and send change
+// events), giving up at the deadline
+static int
+tempd_shutdown_notify(struct locl_sensor *sensor, long long int deadline)
+{
+    const struct ovsrec_temp_sensor *ovs_sensor;
+    struct ovsdb_idl_txn *txn;
+    enum ovsdb_idl_txn_status status;
+
+    // subscribers get whatever can be sent without blocking
+    tempd_events_collect();
+    tempd_events_run();
+
+    ovs_sensor = lookup_sensor(sensor->name);
+    if (ovs_sensor == NULL) {
+        return(ENOENT);
+    }
+
+    txn = ovsdb_idl_txn_create(idl);
+    ovsrec_temp_sensor_set_status(ovs_sensor,
+        sensor_status_to_string(sensor->status));
+    for (;;) {
+        ovsdb_idl_run(idl);
+        status = ovsdb_idl_txn_commit(txn);
+        if (status != TXN_INCOMPLETE || time_msec() >= deadline) {
+            break;
+        }
+        ovsdb_idl_wait(idl);
+        ovsdb_idl_txn_wait(txn);
+        poll_timer_wait_until(deadline);
+        poll_block();
+    }
+    ovsdb_idl_txn_destroy(txn);
+
+    if (status == TXN_SUCCESS || status == TXN_UNCHANGED) {
+        return(0);
+    }
+    return(status == TXN_INCOMPLETE ? ETIMEDOUT : EIO);
+}
+
+// shutdown stage: run EMERGENCY_POWEROFF (directly, not through a shell),
+// and wait until the deadline for it to take effect. a stub is run in its
+// place, with the same arguments.
+static int
+tempd_shutdown_poweroff(long long int deadline)
+{
+    char *argv[] = { EMERGENCY_POWEROFF, NULL };
+    struct timespec delay = { 0, 50 * 1000 * 1000 };
+    int status;
+    pid_t pid;
+
+    if (emergency_action == EMERGENCY_ACTION_STUB) {
+        VLOG_WARN("Emergency action is stubbed, running %s", emergency_stub);
+        argv[0] = emergency_stub;
+    }
+
+    pid = fork();
+    if (pid < 0) {
+        return(errno);
+    }
+    if (pid == 0) {
+        execv(argv[0], argv);
+        _exit(127);
+    }
+
+    while (time_msec() < deadline) {
+        if (pid > 0 && waitpid(pid, &status, WNOHANG) == pid) {
+            if (!WIFEXITED(status) || WEXITSTATUS(status) != 0) {
+                VLOG_ERR("%s failed (status %d)", argv[0], status);
+                return(ECHILD);
+            }
+            // the power off has been started, wait for it
+            pid = 0;
+        }
+        nanosleep(&delay, NULL);
+    }
+
+    return(ETIMEDOUT);
+}
+
+// shutdown stage: power off from here, if EMERGENCY_POWEROFF didn't
+static int
+tempd_shutdown_escalate(void)
+{
+    if (emergency_action == EMERGENCY_ACTION_STUB) {
+        VLOG_WARN("Emergency action is stubbed, not calling reboot()");
+        return(0);
     }
+
+    sync();
+    reboot(RB_POWER_OFF);
+    // only returns on failure
+    return(errno);
 }
 
-// pre-exit shutdown processing
+// shut the system down because a sensor is in an emergency state. the
+// stages run in order, and each stage's time is recorded. this doesn't
+// return, unless the emergency action is stubbed.
 static void
-tempd_exit(void)
+tempd_emergency_shutdown(struct locl_sensor *sensor)
 {
-    ovsdb_idl_destroy(idl);
+    struct locl_shutdown *sd = &shutdown_info;
+    int stage;
+
+    if (sd->sensor != NULL) {
+        // the (test) shutdown has already run
+        return;
+    }
+
+    memset(sd, 0, sizeof(*sd));
+    sd->sensor = xstrdup(sensor->name);
+    sd->start = time_msec();
+
+    for (stage = 0; stage < SHUTDOWN_N_STAGES; stage++) {
+        long long int begin = time_msec();
+        int rc = 0;
+
+        switch (stage) {
+        case SHUTDOWN_RECORD:
+            rc = tempd_shutdown_record(sensor);
+            break;
+        case SHUTDOWN_NOTIFY:
+            // optional: don't let it delay the power off any further
+            if (begin - sd->start > SHUTDOWN_RECORD_BUDGET_MSEC) {
+                VLOG_WARN("Emergency shutdown: skipping %s stage",
+                          shutdown_stage_to_string(stage));
+                continue;
+            }
+            rc = tempd_shutdown_notify(sensor,
+                                       begin + SHUTDOWN_NOTIFY_BUDGET_MSEC);
+            break;
+        case SHUTDOWN_POWEROFF:
+            rc = tempd_shutdown_poweroff(begin +
+                                         SHUTDOWN_POWEROFF_DEADLINE_MSEC);
+            break;
+        case SHUTDOWN_ESCALATE:
+            rc = tempd_shutdown_escalate();
+            break;
+        }
+
+        sd->ran[stage] = true;
+        sd->msec[stage] = time_msec() - begin;
+        sd->rc[stage] = rc;
+        VLOG_WARN("Emergency shutdown stage %s: %d ms (%s)",
+                  shutdown_stage_to_string(stage), sd->msec[stage],
+                  rc ? ovs_strerror(rc) : "ok");
+    }
+
+    if (emergency_action == EMERGENCY_ACTION_STUB) {
+        return;
+    }
+
+    // shouldn't get here
+    VLOG_ERR("Emergency shutdown failed, the system is still running");
+    tempd_recorder_flush(true);
+    while (1) {
+        sleep(1000);
+    }
 }
 
 // poll every sensor for new temperature and update db with any new results
@@ -565,41 +3910,44 @@ tempd_run__(void)
     const struct ovsrec_temp_sensor *cfg;
     const struct ovsrec_daemon *db_daemon;
     struct shash_node *node;
-    struct shash_node *sensor_node;
     struct locl_sensor *sensor;
     bool change = false;
+    bool stats_due = false;
+    bool samples_due = false;
+
+    // read all sensors
+    sensor = tempd_poll_sensors();
+    if (sensor != NULL) {
+        // if a sensor is still in an emergency sitaution after a re-read,
+        // and the subsystem indicates that we should shutdown, do so.
+        tempd_emergency_shutdown(sensor);
+    }
 
-    SHASH_FOR_EACH(node, &subsystem_data) {
-        struct locl_subsystem *subsystem = (struct locl_subsystem *)node->data;
-        SHASH_FOR_EACH(sensor_node, &subsystem->subsystem_sensors) {
-            sensor = (struct locl_sensor *)sensor_node->data;
-            tempd_read_sensor(sensor);
-            if (sensor->status == SENSOR_STATUS_EMERGENCY) {
-                // if we're in an emergency situation, verify that the sensor
-                // was read correctly (by reading it again).
-                tempd_read_sensor(sensor);
-                if (sensor->status == SENSOR_STATUS_EMERGENCY) {
-                    // if we're still in an emergency sitaution, and the
-                    // subsystem indicates that we should shutdown, do so.
-                    if (subsystem->emergency_shutdown == true) {
-                        VLOG_WARN("Emergency shutdown initiated for sensor %s",
-                                sensor->name);
-                        log_event("TEMP_SENSOR_SHUTDOWN",
-                            EV_KV("name", "%s", sensor->name));
-                        system(EMERGENCY_POWEROFF);
-                        // shouldn't continue
-                        while (1) {
-                            sleep(1000);
-                        }
-                    }
-                }
-            }
-        }
+    // queue change events for subscribers
+    tempd_events_collect();
+    // checkpoint state for a warm restart
+    tempd_state_save();
+
+    if (time_msec() >= recorder_next_flush) {
+        tempd_recorder_flush(false);
+        recorder_next_flush = time_msec() + RECORDER_FLUSH_PERIOD * MSEC_PER_SEC;
+    }
+
+    if (publish_stats && time_msec() >= stats_next_publish) {
+        stats_due = true;
+        stats_next_publish = time_msec() + STATS_PUBLISH_PERIOD * MSEC_PER_SEC;
+    }
+
+    if (publish_samples && time_msec() >= samples_next_publish) {
+        samples_due = true;
+        samples_next_publish = time_msec() +
+                               SAMPLE_PUBLISH_PERIOD * MSEC_PER_SEC;
     }
 
     txn = ovsdb_idl_txn_create(idl);
     OVSREC_TEMP_SENSOR_FOR_EACH(cfg, idl) {
         const char *status;
+        bool samples;
         node = shash_find(&sensor_data, cfg->name);
         if (node == NULL) {
             VLOG_WARN("unable to find matching sensor for %s", cfg->name);
@@ -645,241 +3993,1081 @@ tempd_run__(void)
             ovsrec_temp_sensor_set_location(cfg, sensor->yaml_sensor->location);
             change = true;
         }
-    }
+        // set rolling statistics and sample times (at a coarse rate, and
+        // as soon as a sensor's read quality changes) and fan duty
+        samples = publish_samples &&
+                  (samples_due ||
+                   sensor->published_quality != (int)sensor->quality);
+        if (stats_due || samples ||
+                (sensor->duty != NULL && tempd_duty_due(sensor->duty))) {
+            tempd_publish_external_ids(sensor, cfg, stats_due, samples);
+            change = true;
+        }
+    }
+
+    // If first time through, set cur_hw = 1
+    if (!cur_hw_set) {
+        OVSREC_DAEMON_FOR_EACH(db_daemon, idl) {
+            if (strncmp(db_daemon->name, NAME_IN_DAEMON_TABLE,
+                            strlen(NAME_IN_DAEMON_TABLE)) == 0) {
+                ovsrec_daemon_set_cur_hw(db_daemon, (int64_t) 1);
+                cur_hw_set = true;
+                change = true;
+                break;
+            }
+        }
+    }
+
+    // if a change was made, execute the transaction
+    if (change == true) {
+        ovsdb_idl_txn_commit_block(txn);
+    }
+    ovsdb_idl_txn_destroy(txn);
+}
+
+// lookup a local subsystem structure
+// if it's not found, create a new one and initialize it
+static struct locl_subsystem *
+get_subsystem(const struct ovsrec_subsystem *ovsrec_subsys)
+{
+    void *ptr;
+    struct locl_subsystem *result = NULL;
+
+    ptr = shash_find_data(&subsystem_data, ovsrec_subsys->name);
+
+    if (ptr == NULL) {
+        // this subsystem has not been added, yet. Do that now.
+        result = add_subsystem(ovsrec_subsys);
+    } else {
+        result = (struct locl_subsystem *)ptr;
+        if (!result->valid) {
+            result = NULL;
+        }
+    }
+
+    return(result);
+}
+
+// set the "marked" value for each subsystem to false.
+static void
+tempd_unmark_subsystems(void)
+{
+    struct shash_node *node;
+
+    SHASH_FOR_EACH(node, &subsystem_data) {
+        struct locl_subsystem *subsystem = (struct locl_subsystem *)node->data;
+        subsystem->marked = false;
+    }
+}
+
+// delete all subsystems that haven't been marked
+// this is a helper function for deleting subsystems that no longer exist
+// in the DB
+static void
+tempd_remove_unmarked_subsystems(void)
+{
+    struct shash_node *node, *next;
+    struct shash_node *temp_node, *temp_next;
+    struct shash_node *global_node;
+    size_t idx;
+
+    SHASH_FOR_EACH_SAFE(node, next, &subsystem_data) {
+        struct locl_subsystem *subsystem = node->data;
+
+        if (subsystem->marked == false) {
+            // also, delete all temp sensors in the subsystem
+            SHASH_FOR_EACH_SAFE(temp_node, temp_next, &subsystem->subsystem_sensors) {
+                struct locl_sensor *temp = (struct locl_sensor *)temp_node->data;
+                // delete the sensor_data entry
+                global_node = shash_find(&sensor_data, temp->name);
+                shash_delete(&sensor_data, global_node);
+                // delete the subsystem entry
+                shash_delete(&subsystem->subsystem_sensors, temp_node);
+                // free the allocated data
+                tempd_alert_close(temp);
+                free(temp->inject);
+                tempd_sensor_clear_static(temp);
+                tempd_state_free(temp->state_slot);
+                tempd_bus_remove_sensor(temp);
+                tempd_composite_free(temp);
+                tempd_duty_free(temp);
+                free(temp->yaml_sensor);
+                free(temp->dependents);
+                free(temp->name);
+                free(temp);
+            }
+            free(subsystem->composites);
+            for (idx = 0; idx < subsystem->n_peer_groups; idx++) {
+                free(subsystem->peer_groups[idx]->name);
+                free(subsystem->peer_groups[idx]);
+            }
+            free(subsystem->peer_groups);
+            json_destroy(subsystem->ext);
+            free(subsystem->hw_desc_dir);
+            free(subsystem->name);
+            free(subsystem);
+
+            // delete the subsystem dictionary entry
+            shash_delete(&subsystem_data, node);
+
+            // OPS_TODO: need to remove subsystem yaml data
+        }
+    }
+}
+
+// process any changes to cached data
+static void
+tempd_reconfigure(struct ovsdb_idl *idl)
+{
+    const struct ovsrec_subsystem *subsys;
+    unsigned int new_idl_seqno = ovsdb_idl_get_seqno(idl);
+
+    COVERAGE_INC(tempd_reconfigure);
+
+    if (new_idl_seqno == idl_seqno){
+        return;
+    }
+
+    idl_seqno = new_idl_seqno;
+    state_seqno++;
+
+    // handle any added or deleted subsystems
+    tempd_unmark_subsystems();
+
+    OVSREC_SUBSYSTEM_FOR_EACH(subsys, idl) {
+        struct locl_subsystem *subsystem;
+        // get_subsystem will create a new one if it was added
+        subsystem = get_subsystem(subsys);
+        if (subsystem == NULL) continue;
+        subsystem->marked = true;
+    }
+
+    // remove any subsystems that are no longer present in the db
+    tempd_remove_unmarked_subsystems();
+}
+
+// perform all of the per-loop processing
+static void
+tempd_run(void)
+{
+    ovsdb_idl_run(idl);
+
+    if (!ovsdb_idl_has_lock(idl)) {
+        static struct vlog_rate_limit rl = VLOG_RATE_LIMIT_INIT(1, 1);
+
+        if (ovsdb_idl_is_lock_contended(idl)) {
+            VLOG_INFO_RL(&rl, "another ops-tempd process is running, "
+                         "this process is in standby until it goes away");
+        }
+        if (active) {
+            VLOG_WARN("lost the ops_tempd lock, going to standby");
+            active = false;
+            state_seqno++;
+            tempd_recorder_close();
+            tempd_state_attach(false);
+            tempd_events_close();
+        }
+
+        // stay warm: load hardware descriptions (and optionally read the
+        // sensors) so that a takeover only has to publish
+        tempd_reconfigure(idl);
+        // clean up after bus recovery started before the lock was lost
+        tempd_bus_reap();
+        if (standby_read_period > 0 && !shash_is_empty(&sensor_data) &&
+                time_msec() >= standby_next_read) {
+            (void)tempd_poll_sensors();
+            standby_next_read = time_msec() +
+                                standby_read_period * MSEC_PER_SEC;
+        }
+        daemonize_complete();
+        return;
+    }
+
+    if (!active) {
+        active = true;
+        state_seqno++;
+        lock_acquired_msec = time_msec();
+        takeover_msec = -1;
+        takeovers++;
+        // only the process holding the lock records, and checkpoints
+        if (strcmp(recorder_path, "none") != 0) {
+            (void)tempd_recorder_open(recorder_path);
+        }
+        tempd_state_attach(true);
+        tempd_events_open();
+    }
+
+    // handle changes to cache
+    tempd_reconfigure(idl);
+    // add any subsystems loaded in standby to the db
+    tempd_publish_subsystems();
+    // clear any hardware alerts that woke us up
+    tempd_alert_ack();
+    // clean up after bus recovery
+    tempd_bus_reap();
+    // poll all sensors and report changes into db
+    tempd_run__();
+
+    if (takeover_msec < 0) {
+        takeover_msec = time_msec() - lock_acquired_msec;
+        VLOG_INFO("acquired the ops_tempd lock, first results published "
+                  "in %lld ms", takeover_msec);
+    }
+
+    daemonize_complete();
+    vlog_enable_async();
+    VLOG_INFO_ONCE("%s (OpenSwitch tempd) %s", program_name, VERSION);
+}
+
+// initialize periodic poll of sensors
+static void
+tempd_wait(void)
+{
+    struct shash_node *node;
+    bool all_alerts = !shash_is_empty(&sensor_data);
+
+    ovsdb_idl_wait(idl);
+
+    // in standby, only wake up for db changes and shadow reads (alerts
+    // are only acknowledged by the active process)
+    if (!active) {
+        if (standby_read_period > 0 && !shash_is_empty(&sensor_data)) {
+            poll_timer_wait_until(standby_next_read);
+        }
+        return;
+    }
+
+    // wake up immediately on any hardware alert
+    SHASH_FOR_EACH(node, &sensor_data) {
+        struct locl_sensor *sensor = (struct locl_sensor *)node->data;
+        if (sensor->alert_fd >= 0) {
+            poll_fd_wait(sensor->alert_fd,
+                         tempd_alert_events(sensor->alert_fd));
+        } else {
+            all_alerts = false;
+        }
+    }
+
+    // if every sensor can alert, periodic polling is only needed to
+    // track the temperature, so it can be done less often
+    if (all_alerts) {
+        poll_timer_wait(ALERT_POLLING_PERIOD * MSEC_PER_SEC);
+    } else {
+        poll_timer_wait(POLLING_PERIOD * MSEC_PER_SEC);
+    }
+}
+
+// put a wall clock time (msec) as local time. the dump is cached, so it
+// shows times rather than ages, which would be frozen.
+static void
+tempd_dump_wall(struct ds *ds, long long int wall)
+{
+    time_t secs = wall / MSEC_PER_SEC;
+    struct tm tm;
+    char buf[32];
+
+    strftime(buf, sizeof(buf), "%Y-%m-%d %H:%M:%S", localtime_r(&secs, &tm));
+    ds_put_format(ds, "%s.%03lld", buf, wall % MSEC_PER_SEC);
+}
+
+// put a time from tempd_time_msec() as local wall clock time
+static void
+tempd_dump_time(struct ds *ds, long long int msec)
+{
+    tempd_dump_wall(ds, tempd_wall_msec(msec));
+}
+
+// render the support dump's header: the daemon's own state. called when a
+// snapshot is taken.
+static void
+tempd_dump_header(struct ds *ds)
+{
+    ds_put_cstr(ds, "Support Dump for Platform Temperature Daemon (ops-tempd)\n");
+    ds_put_format(ds, "State: %s (takeovers %u", active ? "active" : "standby",
+                  takeovers);
+    if (takeover_msec >= 0) {
+        ds_put_format(ds, ", last takeover %lld ms", takeover_msec);
+    }
+    ds_put_cstr(ds, ")\n");
+    if (last_poll_msec >= 0) {
+        ds_put_cstr(ds, "Last poll: ");
+        tempd_dump_time(ds, last_poll_msec);
+        ds_put_format(ds, " (%llu polls)\n", polls);
+    }
+    if (simulated_emergencies > 0) {
+        ds_put_format(ds, "Emergency shutdown: skipped %u time(s) for "
+                      "simulated temperatures\n", simulated_emergencies);
+    }
+    if (shutdown_info.sensor != NULL) {
+        int stage;
+
+        ds_put_format(ds, "Emergency shutdown: sensor %s\n",
+                      shutdown_info.sensor);
+        for (stage = 0; stage < SHUTDOWN_N_STAGES; stage++) {
+            if (!shutdown_info.ran[stage]) {
+                ds_put_format(ds, "\t%s: skipped\n",
+                              shutdown_stage_to_string(stage));
+                continue;
+            }
+            ds_put_format(ds, "\t%s: %d ms (%s)\n",
+                          shutdown_stage_to_string(stage),
+                          shutdown_info.msec[stage],
+                          shutdown_info.rc[stage] ?
+                          ovs_strerror(shutdown_info.rc[stage]) : "ok");
+        }
+    }
+    if (tempd_recorder_is_open()) {
+        struct tempd_recorder_stats stats;
+
+        tempd_recorder_get_stats(&stats);
+        ds_put_format(ds, "Flight recorder: %s (%llu readings, %llu bytes, "
+                      "%u rotations)\n", recorder_path, stats.readings,
+                      stats.bytes, stats.rotations);
+    }
+    if (events_listener != NULL) {
+        unsigned int dropped = 0;
+        size_t i;
+
+        for (i = 0; i < n_subscribers; i++) {
+            dropped += subscribers[i]->dropped;
+        }
+        ds_put_format(ds, "Change events: %s (%zu subscriber(s), %u event(s) "
+                      "coalesced)\n", events_path, n_subscribers, dropped);
+    }
+}
+
+// render the support dump's i2c bus and bus lock sections. called when a
+// snapshot is taken.
+static void
+tempd_dump_buses(struct ds *ds)
+{
+    struct shash_node *snode;
+
+    if (!shash_is_empty(&bus_data)) {
+        ds_put_cstr(ds, "\nI2C buses:\n");
+    }
+    SHASH_FOR_EACH(snode, &bus_data) {
+        struct locl_bus *bus = (struct locl_bus *)snode->data;
+
+        ds_put_format(ds, "\tBus %s: breaker %s (failures %d, trips %u",
+                      bus->name, breaker_state_to_string(bus->breaker.state),
+                      bus->breaker.failures, bus->breaker.trips);
+        if (bus->breaker.state == BREAKER_OPEN) {
+            ds_put_cstr(ds, ", next probe at ");
+            tempd_dump_time(ds, bus->breaker.next_probe);
+        }
+        ds_put_format(ds, "), recoveries %u\n", bus->recoveries);
+    }
+
+    if (bus_lock_dir != NULL && !shash_is_empty(&buslock_data)) {
+        ds_put_format(ds, "\nI2C bus locks (%s):\n", bus_lock_dir);
+    }
+    SHASH_FOR_EACH(snode, &buslock_data) {
+        struct locl_buslock *lock = (struct locl_buslock *)snode->data;
+
+        if (bus_lock_dir == NULL) {
+            break;
+        }
+        ds_put_format(ds, "\tLock %s: %zu bus(es), windows %u, timeouts %u, "
+                      "wait %lld ms\n", lock->name, lock->n_buses,
+                      lock->windows, lock->timeouts, lock->wait_msec);
+    }
+}
+
+// render the support dump from a snapshot. only called when the snapshot
+// has no cached copy, i.e. once per state change.
+static void
+tempd_dump_text(struct ds *ds, const struct tempd_snapshot *snap)
+{
+    const char *subsystem = NULL;
+    size_t idx;
+    int window;
+
+    ds_put_cstr(ds, snap->strings + snap->text_header);
+
+    for (idx = 0; idx < snap->n_sensors; idx++) {
+        const struct snapshot_sensor *sensor = &snap->sensors[idx];
+
+        // sensors are in dump order, grouped by subsystem
+        if (subsystem == NULL ||
+                strcmp(subsystem, snap->strings + sensor->subsystem)) {
+            subsystem = snap->strings + sensor->subsystem;
+            ds_put_format(ds, "\nSubsystem: %s\n", subsystem);
+        }
 
-    // If first time through, set cur_hw = 1
-    if (!cur_hw_set) {
-        OVSREC_DAEMON_FOR_EACH(db_daemon, idl) {
-            if (strncmp(db_daemon->name, NAME_IN_DAEMON_TABLE,
-                            strlen(NAME_IN_DAEMON_TABLE)) == 0) {
-                ovsrec_daemon_set_cur_hw(db_daemon, (int64_t) 1);
-                cur_hw_set = true;
-                change = true;
-                break;
+        ds_put_format(ds, "\tSensor name: %s\n", snap->strings + sensor->name);
+        ds_put_cstr(ds, snap->strings + sensor->text_info);
+        ds_put_format(ds, "\t\tStatus: %s\n",
+                            sensor_status_to_string(sensor->status));
+        ds_put_format(ds, "\t\tFan speed: %s\n",
+                            sensor_speed_to_string(sensor->fan_speed));
+        if (sensor->has_duty) {
+            ds_put_format(ds, "\t\tFan duty: %.1f%% (%s, rise %.2f "
+                        "C/min, published %d%%)\n", sensor->duty,
+                        duty_mode_to_string(sensor->duty_mode),
+                        sensor->duty_slope, sensor->duty_published);
+        }
+        ds_put_format(ds, "\t\tTemperature: %d\n", sensor->temp / 1000);
+        ds_put_format(ds, "\t\tMin temp: %d\n", sensor->min / 1000);
+        ds_put_format(ds, "\t\tMax temp: %d\n", sensor->max / 1000);
+        ds_put_format(ds, "\t\tFault count: %d\n", sensor->fault_count);
+        ds_put_format(ds, "\t\tTransitions: %u logged, %u rate limited\n",
+                            sensor->logged, sensor->suppressed);
+        if (!sensor->composite) {
+            ds_put_format(ds, "\t\tImplausible readings: %u (max rate "
+                        "%.1f C/s, peers %s)\n", sensor->implausible,
+                        sensor->max_rate / MILI_DEGREES_FLOAT,
+                        snap->strings + sensor->peers);
+        }
+        ds_put_format(ds, "\t\tHardware alert: %s\n",
+                    sensor->alert ? "armed" : "none");
+        ds_put_format(ds, "\t\tBreaker: %s (failures %d, trips %u, "
+                    "backoff %d ms)\n",
+                    breaker_state_to_string(sensor->breaker.state),
+                    sensor->breaker.failures, sensor->breaker.trips,
+                    sensor->breaker.backoff);
+        ds_put_format(ds, "\t\tLast read: %d ms\n", sensor->read_msec);
+        if (sensor->sampled >= 0) {
+            ds_put_format(ds, "\t\tSample: %s, at ",
+                    read_quality_to_string(sensor->quality));
+            tempd_dump_wall(ds, sensor->sampled);
+            ds_put_char(ds, '\n');
+        } else {
+            ds_put_format(ds, "\t\tSample: %s, never good\n",
+                    read_quality_to_string(sensor->quality));
+        }
+        for (window = 0; window < STATS_N_WINDOWS; window++) {
+            const struct stats_result *result = &sensor->stats[window];
+
+            if (result->count > 0) {
+                ds_put_format(ds, "\t\t%s: min %.3f avg %.3f max %.3f "
+                            "(%d samples)\n",
+                            stats_window_name(window),
+                            result->min / MILI_DEGREES_FLOAT,
+                            result->avg / MILI_DEGREES_FLOAT,
+                            result->max / MILI_DEGREES_FLOAT,
+                            result->count);
             }
         }
+        if (sensor->injected) {
+            ds_put_format(ds, "\t\tInjection: %s (until ",
+                    inject_profile_to_string(sensor->inject_profile));
+            tempd_dump_wall(ds, sensor->inject_until);
+            ds_put_cstr(ds, ")\n");
+        }
+        ds_put_cstr(ds, snap->strings + sensor->text_config);
     }
 
-    // if a change was made, execute the transaction
-    if (change == true) {
-        ovsdb_idl_txn_commit_block(txn);
-    }
-    ovsdb_idl_txn_destroy(txn);
+    ds_put_cstr(ds, snap->strings + snap->text_buses);
 }
 
-// lookup a local subsystem structure
-// if it's not found, create a new one and initialize it
-static struct locl_subsystem *
-get_subsystem(const struct ovsrec_subsystem *ovsrec_subsys)
+
+static void
+tempd_unixctl_dump(struct unixctl_conn *conn, int argc OVS_UNUSED,
+                          const char *argv[] OVS_UNUSED, void *aux OVS_UNUSED)
 {
-    void *ptr;
-    struct locl_subsystem *result = NULL;
+    struct tempd_snapshot *snap = tempd_snapshot_get();
+    const char *reply = smap_get(&snap->replies, "dump");
 
-    ptr = shash_find_data(&subsystem_data, ovsrec_subsys->name);
+    if (reply != NULL) {
+        unixctl_command_reply(conn, reply);
+    } else {
+        struct ds ds = DS_EMPTY_INITIALIZER;
 
-    if (ptr == NULL) {
-        // this subsystem has not been added, yet. Do that now.
-        result = add_subsystem(ovsrec_subsys);
+        tempd_dump_text(&ds, snap);
+        tempd_snapshot_cache(snap, "dump", ds_cstr(&ds));
+        unixctl_command_reply(conn, ds_cstr(&ds));
+        ds_destroy(&ds);
+    }
+    tempd_snapshot_unref(snap);
+}
+
+// append one sensor, with the requested fields, as a json object
+static void
+tempd_dump_json_sensor(struct ds *ds, const struct tempd_snapshot *snap,
+                       const struct snapshot_sensor *sensor,
+                       unsigned int fields)
+{
+    ds_put_cstr(ds, "{\"name\":");
+    json_put_string(ds, snap->strings + sensor->name);
+
+    if (fields & DUMP_SUBSYSTEM) {
+        ds_put_cstr(ds, ",\"subsystem\":");
+        json_put_string(ds, snap->strings + sensor->subsystem);
+    }
+    if ((fields & (DUMP_LOCATION | DUMP_DEVICE | DUMP_TYPE)) ==
+            (DUMP_LOCATION | DUMP_DEVICE | DUMP_TYPE)) {
+        ds_put_cstr(ds, snap->strings + sensor->json_info);
     } else {
-        result = (struct locl_subsystem *)ptr;
-        if (!result->valid) {
-            result = NULL;
+        if (fields & DUMP_LOCATION) {
+            ds_put_cstr(ds, ",\"location\":");
+            json_put_string(ds, snap->strings + sensor->location);
+        }
+        if (fields & DUMP_DEVICE) {
+            ds_put_cstr(ds, ",\"device\":");
+            json_put_string(ds, snap->strings + sensor->device);
+        }
+        if (fields & DUMP_TYPE) {
+            ds_put_cstr(ds, ",\"type\":");
+            json_put_string(ds, snap->strings + sensor->type);
+        }
+    }
+    if (fields & DUMP_STATUS) {
+        ds_put_format(ds, ",\"status\":\"%s\"",
+                      sensor_status_to_string(sensor->status));
+    }
+    if (fields & DUMP_FAN_STATE) {
+        ds_put_format(ds, ",\"fan_state\":\"%s\"",
+                      sensor_speed_to_string(sensor->fan_speed));
+        if (sensor->has_duty) {
+            ds_put_format(ds, ",\"fan_duty\":%.1f", sensor->duty);
         }
     }
+    if (fields & DUMP_TEMPERATURE) {
+        ds_put_format(ds, ",\"temperature\":%d", sensor->temp);
+    }
+    if (fields & DUMP_MIN) {
+        ds_put_format(ds, ",\"min\":%d", sensor->min);
+    }
+    if (fields & DUMP_MAX) {
+        ds_put_format(ds, ",\"max\":%d", sensor->max);
+    }
+    if (fields & DUMP_FAULT_COUNT) {
+        ds_put_format(ds, ",\"fault_count\":%d", sensor->fault_count);
+        ds_put_format(ds, ",\"implausible\":%u", sensor->implausible);
+    }
+    if (fields & DUMP_BREAKER) {
+        ds_put_format(ds, ",\"breaker\":{\"state\":\"%s\",\"failures\":%d,"
+                      "\"trips\":%u,\"backoff\":%d}",
+                      breaker_state_to_string(sensor->breaker.state),
+                      sensor->breaker.failures, sensor->breaker.trips,
+                      sensor->breaker.backoff);
+    }
+    if (fields & DUMP_THRESHOLDS) {
+        ds_put_cstr(ds, snap->strings + sensor->json_thresholds);
+    }
+    if (fields & DUMP_SAMPLE) {
+        ds_put_format(ds, ",\"sample\":{\"quality\":\"%s\",\"time\":%lld}",
+                      read_quality_to_string(sensor->quality),
+                      sensor->sampled);
+    }
+    if (fields & DUMP_TRANSITIONS) {
+        ds_put_format(ds, ",\"transitions\":{\"logged\":%u,"
+                      "\"rate_limited\":%u}", sensor->logged,
+                      sensor->suppressed);
+    }
+    if (fields & DUMP_STATS) {
+        int window;
 
-    return(result);
+        ds_put_cstr(ds, ",\"stats\":{");
+        for (window = 0; window < STATS_N_WINDOWS; window++) {
+            const struct stats_result *result = &sensor->stats[window];
+
+            ds_put_format(ds, "%s\"%s\":{\"min\":%d,\"avg\":%d,\"max\":%d,"
+                          "\"samples\":%d}", window ? "," : "",
+                          stats_window_name(window), result->min, result->avg,
+                          result->max, result->count);
+        }
+        ds_put_char(ds, '}');
+    }
+    ds_put_char(ds, '}');
 }
 
-// set the "marked" value for each subsystem to false.
+// render the json dump of the sensors matching a target from a snapshot
 static void
-tempd_unmark_subsystems(void)
+tempd_dump_json(struct ds *ds, const struct tempd_snapshot *snap,
+                const char *target, unsigned int fields)
 {
-    struct shash_node *node;
+    bool by_subsystem = false;
+    bool first = true;
+    size_t idx;
+
+    // the target is a subsystem name, or else a sensor name pattern
+    for (idx = 0; idx < snap->n_sensors; idx++) {
+        if (strcmp(snap->strings + snap->sensors[idx].subsystem,
+                   target) == 0) {
+            by_subsystem = true;
+            break;
+        }
+    }
 
-    SHASH_FOR_EACH(node, &subsystem_data) {
-        struct locl_subsystem *subsystem = (struct locl_subsystem *)node->data;
-        subsystem->marked = false;
+    ds_put_format(ds, "{\"heartbeat\":%lld,\"sensors\":[", snap->heartbeat);
+    for (idx = 0; idx < snap->n_sensors; idx++) {
+        const struct snapshot_sensor *sensor = &snap->sensors[idx];
+
+        if (by_subsystem) {
+            if (strcmp(snap->strings + sensor->subsystem, target) != 0) {
+                continue;
+            }
+        } else if (fnmatch(target, snap->strings + sensor->name, 0) != 0) {
+            continue;
+        }
+        if (!first) {
+            ds_put_char(ds, ',');
+        }
+        first = false;
+        tempd_dump_json_sensor(ds, snap, sensor, fields);
     }
+    ds_put_cstr(ds, "]}");
 }
 
-// delete all subsystems that haven't been marked
-// this is a helper function for deleting subsystems that no longer exist
-// in the DB
+// compact json dump of sensor state, for scrapers
+// temperatures are in milidegrees (C), thresholds in degrees (C)
 static void
-tempd_remove_unmarked_subsystems(void)
+tempd_unixctl_dump_json(struct unixctl_conn *conn, int argc,
+                        const char *argv[], void *aux OVS_UNUSED)
 {
-    struct shash_node *node, *next;
-    struct shash_node *temp_node, *temp_next;
-    struct shash_node *global_node;
-
-    SHASH_FOR_EACH_SAFE(node, next, &subsystem_data) {
-        struct locl_subsystem *subsystem = node->data;
-
-        if (subsystem->marked == false) {
-            // also, delete all temp sensors in the subsystem
-            SHASH_FOR_EACH_SAFE(temp_node, temp_next, &subsystem->subsystem_sensors) {
-                struct locl_sensor *temp = (struct locl_sensor *)temp_node->data;
-                // delete the sensor_data entry
-                global_node = shash_find(&sensor_data, temp->name);
-                shash_delete(&sensor_data, global_node);
-                // delete the subsystem entry
-                shash_delete(&subsystem->subsystem_sensors, temp_node);
-                // free the allocated data
-                free(temp->name);
-                free(temp);
+    const char *target = argc > 1 ? argv[1] : "*";
+    unsigned int fields = DUMP_ALL;
+    struct tempd_snapshot *snap;
+    const char *reply;
+    char *key;
+
+    if (argc > 2) {
+        char *list = xstrdup(argv[2]);
+        char *save_ptr = NULL;
+        char *name;
+
+        fields = 0;
+        for (name = strtok_r(list, ",", &save_ptr); name != NULL;
+                name = strtok_r(NULL, ",", &save_ptr)) {
+            size_t i;
+
+            for (i = 0; i < ARRAY_SIZE(dump_fields); i++) {
+                if (strcmp(name, dump_fields[i].name) == 0) {
+                    fields |= dump_fields[i].field;
+                    break;
+                }
             }
-            free(subsystem->name);
-            free(subsystem);
+            if (i == ARRAY_SIZE(dump_fields)) {
+                free(list);
+                unixctl_command_reply_error(conn, "Unknown field");
+                return;
+            }
+        }
+        free(list);
+    }
 
-            // delete the subsystem dictionary entry
-            shash_delete(&subsystem_data, node);
+    // scrapers repeat the same few queries: keyed by the parsed fields,
+    // so that differently ordered field lists share a reply
+    snap = tempd_snapshot_get();
+    key = xasprintf("dump-json %x %s", fields, target);
+    reply = smap_get(&snap->replies, key);
+    if (reply != NULL) {
+        unixctl_command_reply(conn, reply);
+    } else {
+        struct ds ds = DS_EMPTY_INITIALIZER;
 
-            // OPS_TODO: need to remove subsystem yaml data
-        }
+        tempd_dump_json(&ds, snap, target, fields);
+        tempd_snapshot_cache(snap, key, ds_cstr(&ds));
+        unixctl_command_reply(conn, ds_cstr(&ds));
+        ds_destroy(&ds);
     }
+    free(key);
+    tempd_snapshot_unref(snap);
 }
 
-// process any changes to cached data
-static void
-tempd_reconfigure(struct ovsdb_idl *idl)
+// swap in new thresholds for a sensor, if they changed. the sensor keeps
+// its status, statistics and db row; the new thresholds are applied
+// (with the usual hysteresis) from the next poll. returns true if the
+// thresholds changed.
+static bool
+tempd_swap_thresholds(struct locl_sensor *sensor,
+                      const YamlAlarmThresholds *alarm,
+                      const YamlFanThresholds *fan)
 {
-    const struct ovsrec_subsystem *subsys;
-    unsigned int new_idl_seqno = ovsdb_idl_get_seqno(idl);
+    YamlSensor *old_yaml = sensor->yaml_sensor;
+    YamlSensor *new_yaml;
 
-    COVERAGE_INC(tempd_reconfigure);
+    if (memcmp(&old_yaml->alarm_thresholds, alarm, sizeof(*alarm)) == 0 &&
+            memcmp(&old_yaml->fan_thresholds, fan, sizeof(*fan)) == 0) {
+        return(false);
+    }
 
-    if (new_idl_seqno == idl_seqno){
-        return;
+    new_yaml = xmemdup(old_yaml, sizeof(YamlSensor));
+    new_yaml->alarm_thresholds = *alarm;
+    new_yaml->fan_thresholds = *fan;
+    sensor->yaml_sensor = new_yaml;
+    free(old_yaml);
+
+    VLOG_INFO("%s: thresholds reloaded", sensor->name);
+    tempd_sensor_clear_static(sensor);
+    if (sensor->subsystem->published) {
+        tempd_program_limits(sensor);
     }
+    tempd_composite_touch(sensor);
+    return(true);
+}
 
-    idl_seqno = new_idl_seqno;
+// re-read a subsystem's thresholds from its hardware description (and
+// extension file). the files are parsed into a separate handle, so
+// nothing changes unless they parse.
+static bool
+tempd_reload_subsystem(struct locl_subsystem *subsystem, struct ds *reply)
+{
+    const char *name = subsystem->name;
+    YamlConfigHandle handle;
+    struct json *ext;
+    int sensor_count;
+    int updated = 0;
+    size_t cidx;
+    int idx;
 
-    // handle any added or deleted subsystems
-    tempd_unmark_subsystems();
+    handle = yaml_new_config_handle();
+    if (yaml_add_subsystem(handle, name, subsystem->hw_desc_dir) != 0 ||
+            yaml_parse_devices(handle, name) != 0 ||
+            yaml_parse_thermal(handle, name) != 0) {
+        ds_put_format(reply, "%s: unable to parse h/w description files "
+                      "in %s\n", name, subsystem->hw_desc_dir);
+        yaml_free_config_handle(handle);
+        return(false);
+    }
 
-    OVSREC_SUBSYSTEM_FOR_EACH(subsys, idl) {
-        struct locl_subsystem *subsystem;
-        // get_subsystem will create a new one if it was added
-        subsystem = get_subsystem(subsys);
-        if (subsystem == NULL) continue;
-        subsystem->marked = true;
+    sensor_count = yaml_get_sensor_count(handle, name);
+    for (idx = 0; idx < sensor_count; idx++) {
+        const YamlSensor *parsed = yaml_get_sensor(handle, name, idx);
+        struct locl_sensor *sensor = tempd_find_sensor(subsystem,
+                                                       parsed->number);
+
+        if (sensor == NULL || sensor->composite != NULL) {
+            ds_put_format(reply, "%s: sensor %d is new, restart ops-tempd "
+                          "to add it\n", name, parsed->number);
+            continue;
+        }
+        if (tempd_swap_thresholds(sensor, &parsed->alarm_thresholds,
+                                  &parsed->fan_thresholds)) {
+            updated++;
+        }
+    }
+    yaml_free_config_handle(handle);
+
+    // composites, in evaluation order, so they see their inputs' new
+    // thresholds
+    ext = tempd_ext_load(name, subsystem->hw_desc_dir);
+    for (cidx = 0; cidx < subsystem->n_composites; cidx++) {
+        struct locl_sensor *sensor = subsystem->composites[cidx];
+        YamlSensor yaml = *sensor->yaml_sensor;
+
+        tempd_composite_thresholds(&yaml, sensor->composite,
+                tempd_ext_entry(ext, "composites", yaml.number));
+        if (tempd_swap_thresholds(sensor, &yaml.alarm_thresholds,
+                                  &yaml.fan_thresholds)) {
+            updated++;
+        }
     }
+    json_destroy(ext);
 
-    // remove any subsystems that are no longer present in the db
-    tempd_remove_unmarked_subsystems();
+    ds_put_format(reply, "%s: thresholds updated for %d sensor(s)\n", name,
+                  updated);
+    return(true);
 }
 
-// perform all of the per-loop processing
+// reload thresholds for one subsystem, or all of them
 static void
-tempd_run(void)
+tempd_unixctl_reload(struct unixctl_conn *conn, int argc,
+                     const char *argv[], void *aux OVS_UNUSED)
 {
-    ovsdb_idl_run(idl);
+    struct ds reply = DS_EMPTY_INITIALIZER;
+    struct shash_node *node;
+    int count = 0;
+    bool ok = true;
 
-    if (ovsdb_idl_is_lock_contended(idl)) {
-        static struct vlog_rate_limit rl = VLOG_RATE_LIMIT_INIT(1, 1);
+    SHASH_FOR_EACH(node, &subsystem_data) {
+        struct locl_subsystem *subsystem = (struct locl_subsystem *)node->data;
 
-        VLOG_ERR_RL(&rl, "another ops-tempd process is running, "
-                    "disabling this process until it goes away");
+        if (!subsystem->valid ||
+                (argc > 1 && strcmp(argv[1], subsystem->name) != 0)) {
+            continue;
+        }
+        if (!tempd_reload_subsystem(subsystem, &reply)) {
+            ok = false;
+        }
+        count++;
+    }
+    state_seqno++;
 
-        return;
-    } else if (!ovsdb_idl_has_lock(idl)) {
-        return;
+    if (count == 0) {
+        unixctl_command_reply_error(conn, "No matching subsystem");
+    } else if (!ok) {
+        unixctl_command_reply_error(conn, ds_cstr(&reply));
+    } else {
+        unixctl_command_reply(conn, ds_cstr(&reply));
     }
+    ds_destroy(&reply);
+}
 
-    // handle changes to cache
-    tempd_reconfigure(idl);
-    // poll all sensors and report changes into db
-    tempd_run__();
+// add a sample to a trace
+static void
+tempd_trace_add(struct locl_trace *trace, size_t *allocated,
+                long long int msec, int temp)
+{
+    if (trace->n >= *allocated) {
+        *allocated = *allocated ? *allocated * 2 : 256;
+        trace->msec = xrealloc(trace->msec, *allocated * sizeof *trace->msec);
+        trace->temp = xrealloc(trace->temp, *allocated * sizeof *trace->temp);
+    }
+    trace->msec[trace->n] = msec;
+    trace->temp[trace->n] = temp;
+    trace->n++;
+}
 
-    daemonize_complete();
-    vlog_enable_async();
-    VLOG_INFO_ONCE("%s (OpenSwitch tempd) %s", program_name, VERSION);
+// load a sensor trace. two formats are supported:
+//     <sensor name>.csv: lines of "<seconds>,<degrees C>" or
+//                        "<seconds>,fault" ('#' starts a comment)
+//     <sensor name>.bin: native-endian pairs of int32 msec, int32
+//                        milidegrees (INT32_MIN for a fault)
+// samples must be in time order. returns NULL if there is no trace.
+static struct locl_trace *
+tempd_trace_load(const char *dir, const char *sensor_name)
+{
+    struct locl_trace *trace;
+    size_t allocated = 0;
+    char *path;
+    FILE *fp;
+
+    trace = xzalloc(sizeof *trace);
+
+    path = xasprintf("%s/%s.bin", dir, sensor_name);
+    fp = fopen(path, "rb");
+    if (fp != NULL) {
+        int32_t rec[2];
+
+        while (fread(rec, sizeof rec, 1, fp) == 1) {
+            tempd_trace_add(trace, &allocated, rec[0],
+                            rec[1] == INT32_MIN ? TRACE_FAULT : rec[1]);
+        }
+        fclose(fp);
+        free(path);
+        return(trace);
+    }
+    free(path);
+
+    path = xasprintf("%s/%s.csv", dir, sensor_name);
+    fp = fopen(path, "r");
+    if (fp != NULL) {
+        char line[128];
+        int lineno = 0;
+
+        while (fgets(line, sizeof line, fp) != NULL) {
+            char value[32];
+            double seconds;
+            double temp;
+
+            lineno++;
+            if (line[0] == '#' || line[strspn(line, " \t\r\n")] == '\0') {
+                continue;
+            }
+            if (sscanf(line, "%lf,%31s", &seconds, value) != 2) {
+                VLOG_WARN("%s:%d: unable to parse trace sample", path, lineno);
+                continue;
+            }
+            if (strcmp(value, "fault") == 0) {
+                tempd_trace_add(trace, &allocated, seconds * MSEC_PER_SEC,
+                                TRACE_FAULT);
+            } else if (sscanf(value, "%lf", &temp) == 1) {
+                tempd_trace_add(trace, &allocated, seconds * MSEC_PER_SEC,
+                                temp * MILI_DEGREES);
+            }
+        }
+        fclose(fp);
+        free(path);
+        return(trace);
+    }
+    free(path);
+    free(trace);
+
+    return(NULL);
 }
 
-// initialize periodic poll of sensors
+// print the transitions for one sensor since the last replay step
 static void
-tempd_wait(void)
+tempd_replay_report(struct locl_sensor *sensor, double seconds,
+                    unsigned int *n_status, unsigned int *n_fan,
+                    unsigned int *n_duty, unsigned int *n_db)
 {
-    ovsdb_idl_wait(idl);
-    poll_timer_wait(POLLING_PERIOD * MSEC_PER_SEC);
+    struct locl_trace *trace = sensor->trace;
+    struct ds cols = DS_EMPTY_INITIALIZER;
+
+    if (!trace->published || trace->status != sensor->status) {
+        printf("%.3f,%s,status,%s,%s\n", seconds, sensor->name,
+               trace->published ? sensor_status_to_string(trace->status) : "",
+               sensor_status_to_string(sensor->status));
+        ds_put_cstr(&cols, "status|");
+        (*n_status)++;
+    }
+    if (!trace->published || trace->fan_speed != sensor->fan_speed) {
+        printf("%.3f,%s,fan,%s,%s\n", seconds, sensor->name,
+               trace->published ? sensor_speed_to_string(trace->fan_speed) : "",
+               sensor_speed_to_string(sensor->fan_speed));
+        ds_put_cstr(&cols, "fan_state|");
+        (*n_fan)++;
+    }
+    if (sensor->duty != NULL && tempd_duty_due(sensor->duty)) {
+        int duty = lround(sensor->duty->duty);
+
+        printf("%.3f,%s,duty,", seconds, sensor->name);
+        if (sensor->duty->published >= 0) {
+            printf("%d", sensor->duty->published);
+        }
+        printf(",%d\n", duty);
+        sensor->duty->published = duty;
+        ds_put_cstr(&cols, "external_ids|");
+        (*n_duty)++;
+    }
+    if (!trace->published || trace->temp_db != sensor->temp) {
+        ds_put_cstr(&cols, "temperature|");
+    }
+    if (!trace->published || trace->min_db != sensor->min) {
+        ds_put_cstr(&cols, "min|");
+    }
+    if (!trace->published || trace->max_db != sensor->max) {
+        ds_put_cstr(&cols, "max|");
+    }
+    if (cols.length > 0) {
+        ds_chomp(&cols, '|');
+        printf("%.3f,%s,db,%s,%d\n", seconds, sensor->name, ds_cstr(&cols),
+               sensor->temp);
+        (*n_db)++;
+    }
+    ds_destroy(&cols);
+
+    trace->status = sensor->status;
+    trace->fan_speed = sensor->fan_speed;
+    trace->temp_db = sensor->temp;
+    trace->min_db = sensor->min;
+    trace->max_db = sensor->max;
+    trace->published = true;
 }
 
-static void
-tempd_unixctl_dump(struct unixctl_conn *conn, int argc OVS_UNUSED,
-                          const char *argv[] OVS_UNUSED, void *aux OVS_UNUSED)
+// replay recorded temperature traces for a subsystem through the sensor
+// state machine, in virtual time, and print the resulting status, fan and
+// db write transitions (as csv) on stdout.
+static int
+tempd_replay(const char *trace_dir, const char *hw_desc_dir,
+             const char *subsystem_name)
 {
-    struct ds ds = DS_EMPTY_INITIALIZER;
-    struct shash_node *snode;
-    struct shash_node *tnode;
+    struct locl_subsystem *subsystem;
+    struct shash_node *node;
+    struct timespec start, end;
+    long long int last = 0;
+    unsigned int n_steps = 0;
+    unsigned int n_status = 0, n_fan = 0, n_duty = 0, n_db = 0;
+    unsigned int n_implausible = 0;
+    bool shutdown = false;
+    struct tempd_snapshot *snap;
+    struct ds ds;
+    double elapsed;
 
-    ds_put_cstr(&ds, "Support Dump for Platform Temperature Daemon (ops-tempd)\n");
+    init_subsystems();
+    yaml_handle = yaml_new_config_handle();
 
-    SHASH_FOR_EACH(snode, &subsystem_data) {
-        struct locl_subsystem *subsystem = (struct locl_subsystem *)snode->data;
+    subsystem = xzalloc(sizeof *subsystem);
+    subsystem->name = xstrdup(subsystem_name);
+    shash_init(&subsystem->subsystem_sensors);
+    shash_add(&subsystem_data, subsystem->name, subsystem);
+    if (!tempd_load_subsystem(subsystem, hw_desc_dir)) {
+        return(EXIT_FAILURE);
+    }
 
-        ds_put_format(&ds, "\nSubsystem: %s\n", subsystem->name);
+    SHASH_FOR_EACH(node, &subsystem->subsystem_sensors) {
+        struct locl_sensor *sensor = (struct locl_sensor *)node->data;
 
-        SHASH_FOR_EACH(tnode, &(subsystem->subsystem_sensors)) {
-            struct locl_sensor *sensor = (struct locl_sensor *)tnode->data;
+        if (sensor->composite != NULL) {
+            // computed from the other traces (the trace only keeps the
+            // last reported values)
+            sensor->trace = xzalloc(sizeof *sensor->trace);
+            continue;
+        }
+        sensor->trace = tempd_trace_load(trace_dir, sensor->name);
+        if (sensor->trace == NULL) {
+            size_t allocated = 0;
+
+            VLOG_WARN("No trace for sensor %s, using %d C", sensor->name,
+                      DEFAULT_TEMP);
+            sensor->trace = xzalloc(sizeof *sensor->trace);
+            tempd_trace_add(sensor->trace, &allocated, 0,
+                            DEFAULT_TEMP * MILI_DEGREES);
+        }
+        if (sensor->trace->n > 0) {
+            last = MAX(last, sensor->trace->msec[sensor->trace->n - 1]);
+        }
+    }
+
+    // only record a replay if asked to (to measure the recorder)
+    if (recorder_path != NULL && strcmp(recorder_path, "none") != 0) {
+        (void)tempd_recorder_open(recorder_path);
+    }
+
+    printf("# time,sensor,event,from,to\n");
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    for (virtual_msec = 0; virtual_msec <= last;
+            virtual_msec += POLLING_PERIOD * MSEC_PER_SEC) {
+        struct locl_sensor *emergency = tempd_poll_sensors();
+        double seconds = (double)virtual_msec / MSEC_PER_SEC;
+
+        SHASH_FOR_EACH(node, &subsystem->subsystem_sensors) {
+            tempd_replay_report((struct locl_sensor *)node->data, seconds,
+                                &n_status, &n_fan, &n_duty, &n_db);
+        }
+        if (emergency != NULL && !shutdown) {
+            printf("%.3f,%s,shutdown,,\n", seconds, emergency->name);
+            tempd_recorder_shutdown(emergency->recorder_id);
+            shutdown = true;
+        }
+        n_steps++;
+    }
+    clock_gettime(CLOCK_MONOTONIC, &end);
+
+    SHASH_FOR_EACH(node, &subsystem->subsystem_sensors) {
+        n_implausible +=
+            ((struct locl_sensor *)node->data)->plausibility.rejected;
+    }
+
+    elapsed = (end.tv_sec - start.tv_sec) * 1e9 + (end.tv_nsec - start.tv_nsec);
+    printf("# steps %u, sensors %zu, virtual time %.0f s\n", n_steps,
+           shash_count(&subsystem->subsystem_sensors),
+           (double)last / MSEC_PER_SEC);
+    printf("# status transitions %u, fan transitions %u, duty changes %u, "
+           "db writes %u, implausible readings %u\n", n_status, n_fan,
+           n_duty, n_db, n_implausible);
+    if (n_steps > 0 && !shash_is_empty(&subsystem->subsystem_sensors)) {
+        printf("# %.0f ns per step, %.0f ns per sensor\n",
+               elapsed / n_steps,
+               elapsed / n_steps / shash_count(&subsystem->subsystem_sensors));
+    }
+    if (tempd_recorder_is_open()) {
+        struct tempd_recorder_stats stats;
+
+        tempd_recorder_get_stats(&stats);
+        printf("# recorder %llu readings, %llu bytes (%.1f per reading), "
+               "%u rotations\n", stats.readings, stats.bytes,
+               stats.readings ? (double)stats.bytes / stats.readings : 0.0,
+               stats.rotations);
+        tempd_recorder_close();
+    }
 
-            ds_put_format(&ds, "\tSensor name: %s\n", sensor->name);
-            ds_put_format(&ds, "\t\tLocation: %s\n",
-                                        sensor->yaml_sensor->location);
-            ds_put_format(&ds, "\t\tDevice name: %s\n",
-                                        sensor->yaml_sensor->device);
-            ds_put_format(&ds, "\t\tType: %s\n",
-                                        sensor->yaml_sensor->type);
-            ds_put_format(&ds, "\t\tStatus: %s\n",
-                                sensor_status_to_string(sensor->status));
-            ds_put_format(&ds, "\t\tFan speed: %s\n",
-                                sensor_speed_to_string(sensor->fan_speed));
-            ds_put_format(&ds, "\t\tTemperature: %d\n",
-                                        sensor->temp / 1000);
-            ds_put_format(&ds, "\t\tMin temp: %d\n", sensor->min / 1000);
-            ds_put_format(&ds, "\t\tMax temp: %d\n", sensor->max / 1000);
-            ds_put_format(&ds, "\t\tFault count: %d\n",
-                                        sensor->fault_count);
-            ds_put_format(&ds, "\t\tAlarm Thresholds: \n");
-            ds_put_format(&ds, "\t\t\temergency_on: %.2f\n",
-                        sensor->yaml_sensor->alarm_thresholds.emergency_on);
-            ds_put_format(&ds, "\t\t\temergency_off: %.2f\n",
-                        sensor->yaml_sensor->alarm_thresholds.emergency_off);
-            ds_put_format(&ds, "\t\t\tcritical_on: %.2f\n",
-                        sensor->yaml_sensor->alarm_thresholds.critical_on);
-            ds_put_format(&ds, "\t\t\tcritical_off: %.2f\n",
-                        sensor->yaml_sensor->alarm_thresholds.critical_off);
-            ds_put_format(&ds, "\t\t\tmax_on: %.2f\n",
-                        sensor->yaml_sensor->alarm_thresholds.max_on);
-            ds_put_format(&ds, "\t\t\tmax_off: %.2f\n",
-                        sensor->yaml_sensor->alarm_thresholds.max_off);
-            ds_put_format(&ds, "\t\t\tmin: %.2f\n",
-                        sensor->yaml_sensor->alarm_thresholds.min);
-            ds_put_format(&ds, "\t\t\tlow_crit: %.2f\n",
-                        sensor->yaml_sensor->alarm_thresholds.low_crit);
-            ds_put_format(&ds, "\t\tFan Thresholds: \n");
-            ds_put_format(&ds, "\t\t\tmax_on: %.2f\n",
-                        sensor->yaml_sensor->fan_thresholds.max_on);
-            ds_put_format(&ds, "\t\t\tmax_off: %.2f\n",
-                        sensor->yaml_sensor->fan_thresholds.max_off);
-            ds_put_format(&ds, "\t\t\tfast_on: %.2f\n",
-                        sensor->yaml_sensor->fan_thresholds.fast_on);
-            ds_put_format(&ds, "\t\t\tfast_off: %.2f\n",
-                        sensor->yaml_sensor->fan_thresholds.fast_off);
-            ds_put_format(&ds, "\t\t\tmedium_on: %.2f\n",
-                        sensor->yaml_sensor->fan_thresholds.medium_on);
-            ds_put_format(&ds, "\t\t\tmedium_off: %.2f\n",
-                        sensor->yaml_sensor->fan_thresholds.medium_off);
-        }
-    }
-
-    unixctl_command_reply(conn, ds_cstr(&ds));
+    // the rolling statistics and transition counts as of the last step,
+    // as ops-tempd/dump-json would show them
+    virtual_msec = last_poll_msec;
+    snap = tempd_snapshot_get();
+    ds_init(&ds);
+    tempd_dump_json(&ds, snap, subsystem->name,
+                    DUMP_STATS | DUMP_TRANSITIONS);
+    printf("# dump-json %s\n", ds_cstr(&ds));
     ds_destroy(&ds);
-}
+    tempd_snapshot_unref(snap);
 
+    return(EXIT_SUCCESS);
+}
 
 static unixctl_cb_func ops_tempd_exit;
 
 static char *parse_options(int argc, char *argv[], char **unixctl_path);
+
+// trace replay options (see tempd_replay)
+static const char *replay_dir = NULL;
+static const char *replay_hw_desc_dir = NULL;
+static const char *replay_subsystem = "base";
 OVS_NO_RETURN static void usage(void);
 
 int
@@ -897,6 +5085,13 @@ main(int argc, char *argv[])
     remote = parse_options(argc, argv, &unixctl_path);
     fatal_ignore_sigpipe();
 
+    if (replay_dir != NULL) {
+        if (replay_hw_desc_dir == NULL) {
+            ovs_fatal(0, "--replay requires --hw-desc-dir");
+        }
+        exit(tempd_replay(replay_dir, replay_hw_desc_dir, replay_subsystem));
+    }
+
     ovsrec_init();
 
     daemonize_start();
@@ -914,14 +5109,17 @@ main(int argc, char *argv[])
     while (!exiting) {
         tempd_run();
         unixctl_server_run(unixctl);
+        tempd_events_run();
 
         tempd_wait();
         unixctl_server_wait(unixctl);
+        tempd_events_wait();
         if (exiting) {
             poll_immediate_wake();
         }
         poll_block();
     }
+    tempd_events_close();
     tempd_exit();
     unixctl_server_destroy(unixctl);
 
@@ -940,11 +5138,35 @@ parse_options(int argc, char *argv[], char **unixctl_pathp)
         OPT_DISABLE_SYSTEM,
         DAEMON_OPTION_ENUMS,
         OPT_DPDK,
+        OPT_REPLAY,
+        OPT_HW_DESC_DIR,
+        OPT_SUBSYSTEM,
+        OPT_STANDBY_READ,
+        OPT_EVENTS,
+        OPT_PUBLISH_STATS,
+        OPT_PUBLISH_SAMPLES,
+        OPT_STATE_FILE,
+        OPT_FLIGHT_RECORDER,
+        OPT_EMERGENCY_ACTION,
+        OPT_SIMULATED_SHUTDOWN,
+        OPT_BUS_LOCK_DIR,
     };
     static const struct option long_options[] = {
         {"help",        no_argument, NULL, 'h'},
         {"version",     no_argument, NULL, 'V'},
         {"unixctl",     required_argument, NULL, OPT_UNIXCTL},
+        {"replay",      required_argument, NULL, OPT_REPLAY},
+        {"hw-desc-dir", required_argument, NULL, OPT_HW_DESC_DIR},
+        {"subsystem",   required_argument, NULL, OPT_SUBSYSTEM},
+        {"standby-read-period", required_argument, NULL, OPT_STANDBY_READ},
+        {"events",      required_argument, NULL, OPT_EVENTS},
+        {"publish-stats", no_argument, NULL, OPT_PUBLISH_STATS},
+        {"publish-samples", no_argument, NULL, OPT_PUBLISH_SAMPLES},
+        {"state-file",  required_argument, NULL, OPT_STATE_FILE},
+        {"flight-recorder", required_argument, NULL, OPT_FLIGHT_RECORDER},
+        {"emergency-action", required_argument, NULL, OPT_EMERGENCY_ACTION},
+        {"simulated-shutdown", no_argument, NULL, OPT_SIMULATED_SHUTDOWN},
+        {"bus-lock-dir", required_argument, NULL, OPT_BUS_LOCK_DIR},
         DAEMON_LONG_OPTIONS,
         VLOG_LONG_OPTIONS,
         STREAM_SSL_LONG_OPTIONS,
@@ -974,6 +5196,62 @@ parse_options(int argc, char *argv[], char **unixctl_pathp)
             *unixctl_pathp = optarg;
             break;
 
+        case OPT_REPLAY:
+            replay_dir = optarg;
+            break;
+
+        case OPT_HW_DESC_DIR:
+            replay_hw_desc_dir = optarg;
+            break;
+
+        case OPT_SUBSYSTEM:
+            replay_subsystem = optarg;
+            break;
+
+        case OPT_STANDBY_READ:
+            standby_read_period = atoi(optarg);
+            break;
+
+        case OPT_EVENTS:
+            events_path = xstrdup(optarg);
+            break;
+
+        case OPT_PUBLISH_STATS:
+            publish_stats = true;
+            break;
+
+        case OPT_PUBLISH_SAMPLES:
+            publish_samples = true;
+            break;
+
+        case OPT_STATE_FILE:
+            state_path = xstrdup(optarg);
+            break;
+
+        case OPT_FLIGHT_RECORDER:
+            recorder_path = xstrdup(optarg);
+            break;
+
+        case OPT_EMERGENCY_ACTION:
+            if (strcmp(optarg, "poweroff") == 0) {
+                emergency_action = EMERGENCY_ACTION_POWEROFF;
+            } else if (optarg[0] == '/') {
+                emergency_action = EMERGENCY_ACTION_STUB;
+                emergency_stub = xstrdup(optarg);
+            } else {
+                VLOG_FATAL("unknown emergency action %s (poweroff, or the "
+                           "absolute path of a stub)", optarg);
+            }
+            break;
+
+        case OPT_SIMULATED_SHUTDOWN:
+            simulated_shutdown = true;
+            break;
+
+        case OPT_BUS_LOCK_DIR:
+            bus_lock_dir = xstrdup(optarg);
+            break;
+
         VLOG_OPTION_HANDLERS
         DAEMON_OPTION_HANDLERS
         STREAM_SSL_OPTION_HANDLERS
@@ -1024,8 +5302,36 @@ usage(void)
     vlog_usage();
     printf("\nOther options:\n"
            "  --unixctl=SOCKET        override default control socket name\n"
+           "  --replay=DIR            replay sensor traces from DIR in virtual\n"
+           "                          time, print transitions and exit\n"
+           "  --hw-desc-dir=DIR       h/w description to use with --replay\n"
+           "  --subsystem=NAME        subsystem name to use with --replay\n"
+           "                          (default: base)\n"
+           "  --events=SOCKET         change event socket (default:\n"
+           "                          punix:%s/ops-tempd.events, \"none\"\n"
+           "                          to disable)\n"
+           "  --standby-read-period=SECS  read sensors every SECS seconds\n"
+           "                          while in standby (default: 0, off)\n"
+           "  --publish-stats         write 1m/15m/24h min/avg/max to the db\n"
+           "  --publish-samples       write sample times and read quality to\n"
+           "                          the db\n"
+           "  --state-file=FILE       warm-restart state file (default:\n"
+           "                          %s/ops-tempd.state, \"none\" to\n"
+           "                          disable)\n"
+           "  --flight-recorder=FILE  binary log of every reading (default:\n"
+           "                          %s/ops-tempd.rec, \"none\" to\n"
+           "                          disable; off with --replay unless set)\n"
+           "  --emergency-action=ACTION  poweroff (default), or the path of\n"
+           "                          a stub to run in place of poweroff\n"
+           "                          (reboot() isn't called either)\n"
+           "  --simulated-shutdown    let test and injected temperatures\n"
+           "                          start an emergency shutdown\n"
+           "  --bus-lock-dir=DIR      i2c bus lock files shared with other\n"
+           "                          daemons (default: %s, \"none\"\n"
+           "                          to disable)\n"
            "  -h, --help              display this help message\n"
-           "  -V, --version           display version information\n");
+           "  -V, --version           display version information\n",
+           ovs_rundir(), ovs_rundir(), ovs_logdir(), ovs_rundir());
     exit(EXIT_SUCCESS);
 }
 
@@ -0,0 +1,342 @@
+/*
+ * (c) Copyright 2016 Hewlett Packard Enterprise Development LP
+ *
+ *    Licensed under the Apache License, Version 2.0 (the "License"); you may
+ *    not use this file except in compliance with the License. You may obtain
+ *    a copy of the License at
+ *
+ *         http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *    Unless required by applicable law or agreed to in writing, software
+ *    distributed under the License is distributed on an "AS IS" BASIS, WITHOUT
+ *    WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied. See the
+ *    License for the specific language governing permissions and limitations
+ *    under the License.
+ */
+
+/************************************************************************//**
+ * @ingroup ops-tempd
+ *
+ * @file
+ * Shared i2c bus lock benchmark
+ *
+ *     usage: ops-tempd-busbench [-p DAEMONS] [-b BUSES] [-s SEGMENTS]
+ *                               [-d DEVICES] [-c CYCLES]
+ *
+ * Forks DAEMONS processes that poll DEVICES fake i2c devices each, spread
+ * over BUSES buses with SEGMENTS mux segments per bus, for CYCLES poll
+ * cycles. The fake buses live in shared memory: a transfer holds the bus
+ * (as the kernel adapter lock does) for I2C_XFER_USEC, and selecting a
+ * mux segment is a transfer of its own. A device read that finds the mux
+ * switched away by another process since it was selected fails and is
+ * retried.
+ *
+ * The benchmark runs three times: "unlocked", with every process reading
+ * its devices in its own order; "sorted", with every process reading each
+ * bus's devices grouped by mux segment, but without the locks; and
+ * "locked", grouped by segment and taking the tempd_i2c_lock bus locks,
+ * the way ops-tempd does. "sorted" against "locked" is the effect of the
+ * locks themselves. It reports the poll cycle time, the number of mux
+ * switches and the number of retried reads.
+ ***************************************************************************/
+
+#include <errno.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/wait.h>
+
+#include "tempd_i2c_lock.h"
+
+#define I2C_XFER_USEC       200     // one transfer (register read or mux)
+#define POLL_PERIOD_USEC    20000   // time between poll cycles
+#define MAX_BUSES           16
+#define MAX_DEVICES         64
+
+// fake i2c bus, in shared memory
+struct bench_bus {
+    volatile int busy;          // adapter lock
+    volatile int segment;       // current mux segment
+    unsigned long transfers;
+    unsigned long switches;
+    unsigned long retries;
+};
+
+struct bench_daemon {
+    long long int cycle_usec;   // total
+    long long int max_usec;
+};
+
+struct bench_device {
+    int bus;
+    int segment;
+};
+
+enum bench_mode {
+    BENCH_UNLOCKED = 0,     // devices in no particular order
+    BENCH_SORTED = 1,       // grouped by bus and segment
+    BENCH_LOCKED = 2        // grouped, one bus lock window per bus
+};
+
+// must match bench_mode enum
+static const char *bench_mode_name[] = {
+    "unlocked",
+    "sorted",
+    "locked"
+};
+
+static struct bench_bus *buses;
+static struct bench_daemon *daemons;
+
+static int n_daemons = 4;
+static int n_buses = 2;
+static int n_segments = 4;
+static int n_devices = 8;
+static int n_cycles = 200;
+
+static long long int
+now_usec(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return((long long int)ts.tv_sec * 1000000 + ts.tv_nsec / 1000);
+}
+
+static void
+sleep_usec(long long int usec)
+{
+    struct timespec ts = { usec / 1000000, (usec % 1000000) * 1000 };
+
+    nanosleep(&ts, NULL);
+}
+
+// one transfer: wait for the adapter, hold it for I2C_XFER_USEC
+static void
+bench_xfer_start(struct bench_bus *bus)
+{
+    while (__sync_lock_test_and_set(&bus->busy, 1)) {
+        sleep_usec(20);
+    }
+}
+
+static void
+bench_xfer_end(struct bench_bus *bus)
+{
+    sleep_usec(I2C_XFER_USEC);
+    bus->transfers++;
+    __sync_lock_release(&bus->busy);
+}
+
+// read a device: select its mux segment (if needed), then read it. the
+// read fails if someone else switched the mux in between.
+static void
+bench_read(const struct bench_device *device)
+{
+    struct bench_bus *bus = &buses[device->bus];
+    bool ok;
+
+    for (;;) {
+        if (bus->segment != device->segment) {
+            bench_xfer_start(bus);
+            bus->segment = device->segment;
+            bus->switches++;
+            bench_xfer_end(bus);
+        }
+
+        bench_xfer_start(bus);
+        ok = (bus->segment == device->segment);
+        if (!ok) {
+            bus->retries++;
+        }
+        bench_xfer_end(bus);
+        if (ok) {
+            return;
+        }
+    }
+}
+
+static int
+bench_compare_device(const void *a, const void *b)
+{
+    const struct bench_device *x = a;
+    const struct bench_device *y = b;
+
+    if (x->bus != y->bus) {
+        return(x->bus - y->bus);
+    }
+    return(x->segment - y->segment);
+}
+
+static void
+bench_daemon(int id, enum bench_mode mode, const char *lock_dir)
+{
+    struct bench_device devices[MAX_DEVICES];
+    int fds[MAX_BUSES];
+    long long int start, elapsed;
+    char name[16];
+    int cycle, idx, first;
+
+    // every daemon has devices on every bus and segment, in no
+    // particular order (like a hash table walk)
+    srand(id + 1);
+    for (idx = 0; idx < n_devices; idx++) {
+        devices[idx].bus = rand() % n_buses;
+        devices[idx].segment = rand() % n_segments;
+    }
+
+    if (mode != BENCH_UNLOCKED) {
+        qsort(devices, n_devices, sizeof(devices[0]), bench_compare_device);
+    }
+    if (mode == BENCH_LOCKED) {
+        for (idx = 0; idx < n_buses; idx++) {
+            snprintf(name, sizeof(name), "bench-%d", idx);
+            fds[idx] = tempd_i2c_lock_open(lock_dir, name);
+            if (fds[idx] < 0) {
+                perror(name);
+                _exit(EXIT_FAILURE);
+            }
+        }
+    }
+
+    // start out of phase
+    sleep_usec(rand() % POLL_PERIOD_USEC);
+
+    for (cycle = 0; cycle < n_cycles; cycle++) {
+        start = now_usec();
+        if (mode != BENCH_LOCKED) {
+            for (idx = 0; idx < n_devices; idx++) {
+                bench_read(&devices[idx]);
+            }
+        } else {
+            // one window per bus
+            for (first = 0; first < n_devices; first = idx) {
+                int bus = devices[first].bus;
+
+                tempd_i2c_lock_acquire(fds[bus], 1000);
+                for (idx = first;
+                     idx < n_devices && devices[idx].bus == bus; idx++) {
+                    bench_read(&devices[idx]);
+                }
+                tempd_i2c_lock_release(fds[bus]);
+            }
+        }
+        elapsed = now_usec() - start;
+        daemons[id].cycle_usec += elapsed;
+        if (elapsed > daemons[id].max_usec) {
+            daemons[id].max_usec = elapsed;
+        }
+        sleep_usec(POLL_PERIOD_USEC);
+    }
+    _exit(EXIT_SUCCESS);
+}
+
+static void
+bench_run(enum bench_mode mode, const char *lock_dir)
+{
+    unsigned long transfers = 0, switches = 0, retries = 0;
+    long long int total = 0, max = 0;
+    int idx;
+
+    memset(buses, 0, MAX_BUSES * sizeof(*buses));
+    memset(daemons, 0, n_daemons * sizeof(*daemons));
+    fflush(stdout);
+
+    for (idx = 0; idx < n_daemons; idx++) {
+        pid_t pid = fork();
+
+        if (pid < 0) {
+            perror("fork");
+            exit(EXIT_FAILURE);
+        }
+        if (pid == 0) {
+            bench_daemon(idx, mode, lock_dir);
+        }
+    }
+    while (wait(NULL) > 0 || errno == EINTR) {
+        ;
+    }
+
+    for (idx = 0; idx < n_daemons; idx++) {
+        total += daemons[idx].cycle_usec;
+        if (daemons[idx].max_usec > max) {
+            max = daemons[idx].max_usec;
+        }
+    }
+    for (idx = 0; idx < n_buses; idx++) {
+        transfers += buses[idx].transfers;
+        switches += buses[idx].switches;
+        retries += buses[idx].retries;
+    }
+
+    printf("%-9s %10.2f %10.2f %10lu %10lu %10lu\n",
+           bench_mode_name[mode],
+           total / 1000.0 / (n_daemons * n_cycles), max / 1000.0,
+           transfers, switches, retries);
+}
+
+int
+main(int argc, char *argv[])
+{
+    char lock_dir[] = "/tmp/busbench.XXXXXX";
+    char path[64];
+    int opt, idx;
+
+    while ((opt = getopt(argc, argv, "p:b:s:d:c:")) != -1) {
+        switch (opt) {
+        case 'p':
+            n_daemons = atoi(optarg);
+            break;
+        case 'b':
+            n_buses = atoi(optarg);
+            break;
+        case 's':
+            n_segments = atoi(optarg);
+            break;
+        case 'd':
+            n_devices = atoi(optarg);
+            break;
+        case 'c':
+            n_cycles = atoi(optarg);
+            break;
+        default:
+            fprintf(stderr, "usage: %s [-p DAEMONS] [-b BUSES] [-s SEGMENTS] "
+                    "[-d DEVICES] [-c CYCLES]\n", argv[0]);
+            return(EXIT_FAILURE);
+        }
+    }
+    if (n_daemons < 1 || n_buses < 1 || n_buses > MAX_BUSES ||
+            n_segments < 1 || n_devices < 1 || n_devices > MAX_DEVICES ||
+            n_cycles < 1) {
+        fprintf(stderr, "%s: invalid argument\n", argv[0]);
+        return(EXIT_FAILURE);
+    }
+
+    buses = mmap(NULL, MAX_BUSES * sizeof(*buses) +
+                 n_daemons * sizeof(*daemons), PROT_READ | PROT_WRITE,
+                 MAP_SHARED | MAP_ANONYMOUS, -1, 0);
+    if (buses == MAP_FAILED || mkdtemp(lock_dir) == NULL) {
+        perror(argv[0]);
+        return(EXIT_FAILURE);
+    }
+    daemons = (struct bench_daemon *)&buses[MAX_BUSES];
+
+    printf("%d daemons, %d devices each, %d buses, %d segments per bus, "
+           "%d cycles\n", n_daemons, n_devices, n_buses, n_segments, n_cycles);
+    printf("%-9s %10s %10s %10s %10s %10s\n", "mode", "cycle ms", "max ms",
+           "transfers", "switches", "retries");
+    bench_run(BENCH_UNLOCKED, lock_dir);
+    bench_run(BENCH_SORTED, lock_dir);
+    bench_run(BENCH_LOCKED, lock_dir);
+
+    for (idx = 0; idx < n_buses; idx++) {
+        snprintf(path, sizeof(path), "%s/i2c-bench-%d.lock", lock_dir, idx);
+        unlink(path);
+    }
+    rmdir(lock_dir);
+    return(EXIT_SUCCESS);
+}
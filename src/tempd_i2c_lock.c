@@ -0,0 +1,99 @@
+/*
+ * (c) Copyright 2016 Hewlett Packard Enterprise Development LP
+ *
+ *    Licensed under the Apache License, Version 2.0 (the "License"); you may
+ *    not use this file except in compliance with the License. You may obtain
+ *    a copy of the License at
+ *
+ *         http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *    Unless required by applicable law or agreed to in writing, software
+ *    distributed under the License is distributed on an "AS IS" BASIS, WITHOUT
+ *    WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied. See the
+ *    License for the specific language governing permissions and limitations
+ *    under the License.
+ */
+
+/************************************************************************//**
+ * @ingroup ops-tempd
+ *
+ * @file
+ * Shared i2c bus locks
+ *
+ * This file has no dependencies beyond libc, so that other daemons (and
+ * the bus scheduling benchmark) can use it as is.
+ ***************************************************************************/
+
+#include <errno.h>
+#include <fcntl.h>
+#include <limits.h>
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/file.h>
+
+#include "tempd_i2c_lock.h"
+
+// open (creating if needed) the lock file for a bus. returns an fd, or -1
+// (with errno set).
+int
+tempd_i2c_lock_open(const char *dir, const char *name)
+{
+    char path[PATH_MAX];
+    char *p;
+    int len;
+
+    len = snprintf(path, sizeof(path), "%s/i2c-", dir);
+    if (len < 0 || len + strlen(name) + sizeof(".lock") > sizeof(path)) {
+        errno = ENAMETOOLONG;
+        return(-1);
+    }
+    snprintf(path + len, sizeof(path) - len, "%s.lock", name);
+    for (p = path + len; *p != '\0'; p++) {
+        if (*p == '/') {
+            *p = '_';
+        }
+    }
+
+    return(open(path, O_RDWR | O_CREAT | O_CLOEXEC, 0644));
+}
+
+// lock a bus, waiting at most timeout_msec. returns 0, or ETIMEDOUT (or
+// another errno value if the lock can't be taken at all).
+int
+tempd_i2c_lock_acquire(int fd, int timeout_msec)
+{
+    struct timespec delay = { 0, 500 * 1000 };
+    struct timespec start, now;
+    long long int elapsed;
+
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    for (;;) {
+        if (flock(fd, LOCK_EX | LOCK_NB) == 0) {
+            return(0);
+        }
+        if (errno != EWOULDBLOCK && errno != EINTR) {
+            return(errno);
+        }
+
+        clock_gettime(CLOCK_MONOTONIC, &now);
+        elapsed = (now.tv_sec - start.tv_sec) * 1000 +
+                  (now.tv_nsec - start.tv_nsec) / 1000000;
+        if (elapsed >= timeout_msec) {
+            return(ETIMEDOUT);
+        }
+
+        // back off from 0.5 up to 4 msec
+        nanosleep(&delay, NULL);
+        if (delay.tv_nsec < 4 * 1000 * 1000) {
+            delay.tv_nsec *= 2;
+        }
+    }
+}
+
+void
+tempd_i2c_lock_release(int fd)
+{
+    flock(fd, LOCK_UN);
+}
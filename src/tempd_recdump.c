@@ -0,0 +1,241 @@
+/*
+ * (c) Copyright 2016 Hewlett Packard Enterprise Development LP
+ *
+ *    Licensed under the Apache License, Version 2.0 (the "License"); you may
+ *    not use this file except in compliance with the License. You may obtain
+ *    a copy of the License at
+ *
+ *         http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *    Unless required by applicable law or agreed to in writing, software
+ *    distributed under the License is distributed on an "AS IS" BASIS, WITHOUT
+ *    WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied. See the
+ *    License for the specific language governing permissions and limitations
+ *    under the License.
+ */
+
+/************************************************************************//**
+ * @ingroup ops-tempd
+ *
+ * @file
+ * Flight recorder decoder
+ *
+ *     usage: ops-tempd-recdump FILE...
+ *
+ * Prints the records in each flight recorder file as csv:
+ *
+ *     seconds,sensor,event,value
+ *
+ * where seconds is the time since the start of the file, and event is
+ * "temp" (degrees C), "fault", "state" (status/fan speed) or "shutdown".
+ * To decode rotated files in order, list the oldest first:
+ *
+ *     ops-tempd-recdump ops-tempd.rec.3 ops-tempd.rec.2 ops-tempd.rec.1 \
+ *         ops-tempd.rec
+ ***************************************************************************/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "tempd_recorder.h"
+
+// must match sensorstatus enum (tempd.h)
+static const char *status_names[] = {
+    "uninitialized", "normal", "min", "max", "low_critical", "critical",
+    "fault", "emergency"
+};
+
+// must match fanspeed enum (tempd.h)
+static const char *speed_names[] = {
+    "normal", "medium", "fast", "max"
+};
+
+#define N_NAMES(array)  (sizeof(array) / sizeof(array[0]))
+
+struct recdump_sensor {
+    char *name;
+    int temp;
+};
+
+static struct recdump_sensor *sensors = NULL;
+static size_t n_sensors = 0;
+
+static int
+get_varint(FILE *fp, unsigned long long int *value)
+{
+    int shift = 0;
+    int c;
+
+    *value = 0;
+    do {
+        c = getc(fp);
+        if (c == EOF || shift > 63) {
+            return(-1);
+        }
+        *value |= (unsigned long long int)(c & 0x7f) << shift;
+        shift += 7;
+    } while (c & 0x80);
+    return(0);
+}
+
+static struct recdump_sensor *
+get_sensor(FILE *fp)
+{
+    unsigned long long int id;
+
+    if (get_varint(fp, &id) != 0) {
+        return(NULL);
+    }
+    if (id == 0 || id > n_sensors || sensors[id - 1].name == NULL) {
+        fprintf(stderr, "undefined sensor id %llu\n", id);
+        return(NULL);
+    }
+    return(&sensors[id - 1]);
+}
+
+static int
+define_sensor(FILE *fp)
+{
+    unsigned long long int id;
+    unsigned long long int len;
+
+    if (get_varint(fp, &id) != 0 || get_varint(fp, &len) != 0 ||
+            id == 0 || len > 255) {
+        return(-1);
+    }
+    if (id > n_sensors) {
+        sensors = realloc(sensors, id * sizeof(*sensors));
+        memset(&sensors[n_sensors], 0, (id - n_sensors) * sizeof(*sensors));
+        n_sensors = id;
+    }
+    free(sensors[id - 1].name);
+    sensors[id - 1].name = calloc(1, len + 1);
+    sensors[id - 1].temp = 0;
+    if (fread(sensors[id - 1].name, 1, len, fp) != len) {
+        return(-1);
+    }
+    return(0);
+}
+
+static int
+recdump(const char *path)
+{
+    struct tempd_recorder_header header;
+    unsigned long long int value;
+    struct recdump_sensor *sensor;
+    long long int msec = 0;
+    char started[64];
+    time_t start;
+    FILE *fp;
+    int tag;
+    size_t i;
+
+    fp = fopen(path, "r");
+    if (fp == NULL) {
+        perror(path);
+        return(-1);
+    }
+    if (fread(&header, sizeof(header), 1, fp) != 1 ||
+            header.magic != TEMPD_RECORDER_MAGIC ||
+            header.version != TEMPD_RECORDER_VERSION) {
+        fprintf(stderr, "%s: not a flight recorder file\n", path);
+        fclose(fp);
+        return(-1);
+    }
+
+    // every file defines its own sensors
+    for (i = 0; i < n_sensors; i++) {
+        free(sensors[i].name);
+        sensors[i].name = NULL;
+    }
+
+    start = header.start / 1000;
+    strftime(started, sizeof(started), "%Y-%m-%d %H:%M:%S",
+             localtime(&start));
+    printf("# %s, started %s\n", path, started);
+
+    while ((tag = getc(fp)) != EOF) {
+        int rc = 0;
+
+        switch (tag) {
+        case REC_SENSOR:
+            rc = define_sensor(fp);
+            break;
+        case REC_TIME:
+            rc = get_varint(fp, &value);
+            msec += value;
+            break;
+        case REC_TEMP:
+            sensor = get_sensor(fp);
+            if (sensor == NULL || get_varint(fp, &value) != 0) {
+                rc = -1;
+                break;
+            }
+            // zigzag decode the delta
+            sensor->temp += (int)((value >> 1) ^ -(long long int)(value & 1));
+            printf("%.3f,%s,temp,%.3f\n", msec / 1000.0, sensor->name,
+                   sensor->temp / 1000.0);
+            break;
+        case REC_FAULT:
+        case REC_SHUTDOWN:
+            sensor = get_sensor(fp);
+            if (sensor == NULL) {
+                rc = -1;
+                break;
+            }
+            printf("%.3f,%s,%s,\n", msec / 1000.0, sensor->name,
+                   tag == REC_FAULT ? "fault" : "shutdown");
+            break;
+        case REC_STATE: {
+            int status, speed;
+
+            sensor = get_sensor(fp);
+            status = getc(fp);
+            speed = getc(fp);
+            if (sensor == NULL || speed == EOF) {
+                rc = -1;
+                break;
+            }
+            printf("%.3f,%s,state,%s/%s\n", msec / 1000.0, sensor->name,
+                   status < N_NAMES(status_names) ? status_names[status] : "?",
+                   speed < N_NAMES(speed_names) ? speed_names[speed] : "?");
+            break;
+        }
+        default:
+            fprintf(stderr, "%s: unknown record %d\n", path, tag);
+            rc = -1;
+            break;
+        }
+
+        if (rc != 0) {
+            // most likely the end of a file that wasn't flushed completely
+            printf("# %s: truncated\n", path);
+            break;
+        }
+    }
+
+    fclose(fp);
+    return(0);
+}
+
+int
+main(int argc, char *argv[])
+{
+    int status = EXIT_SUCCESS;
+    int i;
+
+    if (argc < 2) {
+        fprintf(stderr, "usage: %s FILE...\n", argv[0]);
+        return(EXIT_FAILURE);
+    }
+
+    printf("# seconds,sensor,event,value\n");
+    for (i = 1; i < argc; i++) {
+        if (recdump(argv[i]) != 0) {
+            status = EXIT_FAILURE;
+        }
+    }
+    return(status);
+}
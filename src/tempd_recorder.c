@@ -0,0 +1,330 @@
+/*
+ * (c) Copyright 2016 Hewlett Packard Enterprise Development LP
+ *
+ *    Licensed under the Apache License, Version 2.0 (the "License"); you may
+ *    not use this file except in compliance with the License. You may obtain
+ *    a copy of the License at
+ *
+ *         http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *    Unless required by applicable law or agreed to in writing, software
+ *    distributed under the License is distributed on an "AS IS" BASIS, WITHOUT
+ *    WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied. See the
+ *    License for the specific language governing permissions and limitations
+ *    under the License.
+ */
+
+/************************************************************************//**
+ * @ingroup ops-tempd
+ *
+ * @file
+ * Flight recorder
+ ***************************************************************************/
+
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "util.h"
+#include "shash.h"
+#include "timeval.h"
+#include "openvswitch/vlog.h"
+#include "tempd_recorder.h"
+
+VLOG_DEFINE_THIS_MODULE(tempd_recorder);
+
+#define TEMPD_RECORDER_BUFSIZE  (64 * 1024)
+
+// longest record: tag, two varints and a sensor name
+#define TEMPD_RECORDER_MAX_RECORD   (1 + 2 * 10 + 256)
+
+static char *rec_path = NULL;
+static FILE *rec_file = NULL;
+static char *rec_buf = NULL;
+static size_t rec_size;             // bytes in the current file
+static long long int rec_last_time; // -1 until the first REC_TIME
+
+// sensor ids (1-based), kept across rotations
+static struct shash rec_ids = SHASH_INITIALIZER(&rec_ids);
+static char **rec_names = NULL;
+static int *rec_temp = NULL;        // last REC_TEMP value, per id
+static bool *rec_defined = NULL;    // REC_SENSOR written to this file
+static int rec_n_ids = 0;
+
+static struct tempd_recorder_stats rec_stats;
+
+static size_t
+put_varint(uint8_t *p, uint64_t value)
+{
+    size_t n = 0;
+
+    while (value >= 0x80) {
+        p[n++] = (value & 0x7f) | 0x80;
+        value >>= 7;
+    }
+    p[n++] = value;
+    return(n);
+}
+
+static uint64_t
+zigzag(int64_t value)
+{
+    return(((uint64_t)value << 1) ^ (uint64_t)(value >> 63));
+}
+
+static void
+tempd_recorder_write(const uint8_t *data, size_t len)
+{
+    static struct vlog_rate_limit rl = VLOG_RATE_LIMIT_INIT(1, 5);
+
+    if (fwrite(data, 1, len, rec_file) != len) {
+        VLOG_WARN_RL(&rl, "Unable to write flight recorder %s (%s)", rec_path,
+                     ovs_strerror(errno));
+        return;
+    }
+    rec_size += len;
+    rec_stats.bytes += len;
+}
+
+// start a new file: header only, sensors are defined as they're used
+static int
+tempd_recorder_start(void)
+{
+    struct tempd_recorder_header header;
+    int idx;
+
+    rec_file = fopen(rec_path, "w");
+    if (rec_file == NULL) {
+        return(errno);
+    }
+    setvbuf(rec_file, rec_buf, _IOFBF, TEMPD_RECORDER_BUFSIZE);
+
+    rec_size = 0;
+    rec_last_time = -1;
+    for (idx = 0; idx < rec_n_ids; idx++) {
+        rec_temp[idx] = 0;
+        rec_defined[idx] = false;
+    }
+
+    memset(&header, 0, sizeof(header));
+    header.magic = TEMPD_RECORDER_MAGIC;
+    header.version = TEMPD_RECORDER_VERSION;
+    header.start = time_wall_msec();
+    tempd_recorder_write((const uint8_t *)&header, sizeof(header));
+    return(0);
+}
+
+// keep the last TEMPD_RECORDER_FILES files: FILE.2 -> FILE.3, and so on
+static void
+tempd_recorder_shift(void)
+{
+    char *from;
+    char *to;
+    int idx;
+
+    for (idx = TEMPD_RECORDER_FILES - 1; idx > 0; idx--) {
+        from = (idx == 1) ? xstrdup(rec_path)
+                          : xasprintf("%s.%d", rec_path, idx - 1);
+        to = xasprintf("%s.%d", rec_path, idx);
+        (void)rename(from, to);
+        free(from);
+        free(to);
+    }
+}
+
+static void
+tempd_recorder_rotate(void)
+{
+    int rc;
+
+    fclose(rec_file);
+    rec_file = NULL;
+
+    tempd_recorder_shift();
+    rec_stats.rotations++;
+    rc = tempd_recorder_start();
+    if (rc != 0) {
+        VLOG_ERR("Unable to rotate flight recorder %s (%s)", rec_path,
+                 ovs_strerror(rc));
+    }
+}
+
+// open a new file. the previous file (e.g. from before a shutdown) is
+// kept as FILE.1.
+int
+tempd_recorder_open(const char *path)
+{
+    int rc;
+
+    rec_path = xstrdup(path);
+    rec_buf = xmalloc(TEMPD_RECORDER_BUFSIZE);
+    tempd_recorder_shift();
+    rc = tempd_recorder_start();
+    if (rc != 0) {
+        VLOG_ERR("Unable to open flight recorder %s (%s)", path,
+                 ovs_strerror(rc));
+        tempd_recorder_close();
+    }
+    return(rc);
+}
+
+void
+tempd_recorder_close(void)
+{
+    if (rec_file != NULL) {
+        fclose(rec_file);
+        rec_file = NULL;
+    }
+    free(rec_buf);
+    rec_buf = NULL;
+    free(rec_path);
+    rec_path = NULL;
+}
+
+bool
+tempd_recorder_is_open(void)
+{
+    return(rec_file != NULL);
+}
+
+// get the id for a sensor (0 if the recorder isn't open)
+int
+tempd_recorder_sensor(const char *name)
+{
+    int id;
+
+    if (rec_file == NULL) {
+        return(0);
+    }
+
+    id = (intptr_t)shash_find_data(&rec_ids, name);
+    if (id == 0) {
+        id = ++rec_n_ids;
+        rec_names = xrealloc(rec_names, rec_n_ids * sizeof *rec_names);
+        rec_temp = xrealloc(rec_temp, rec_n_ids * sizeof *rec_temp);
+        rec_defined = xrealloc(rec_defined, rec_n_ids * sizeof *rec_defined);
+        rec_names[id - 1] = xstrdup(name);
+        rec_temp[id - 1] = 0;
+        rec_defined[id - 1] = false;
+        shash_add(&rec_ids, name, (void *)(intptr_t)id);
+    }
+    return(id);
+}
+
+// write a record for a sensor, defining the sensor first if needed
+static void
+tempd_recorder_put(enum recordertag tag, int id, const uint8_t *arg,
+                   size_t arg_len)
+{
+    uint8_t record[TEMPD_RECORDER_MAX_RECORD];
+    size_t n = 0;
+
+    if (rec_file == NULL || id <= 0 || id > rec_n_ids) {
+        return;
+    }
+
+    if (!rec_defined[id - 1]) {
+        size_t len = MIN(strlen(rec_names[id - 1]), 255);
+
+        record[n++] = REC_SENSOR;
+        n += put_varint(&record[n], id);
+        n += put_varint(&record[n], len);
+        memcpy(&record[n], rec_names[id - 1], len);
+        n += len;
+        rec_defined[id - 1] = true;
+    }
+
+    record[n++] = tag;
+    n += put_varint(&record[n], id);
+    if (arg_len > 0) {
+        memcpy(&record[n], arg, arg_len);
+        n += arg_len;
+    }
+
+    tempd_recorder_write(record, n);
+}
+
+// start a poll. rotates the file if it's full.
+void
+tempd_recorder_time(long long int now)
+{
+    uint8_t record[1 + 10];
+    size_t n = 0;
+
+    if (rec_file == NULL) {
+        return;
+    }
+    if (rec_size >= TEMPD_RECORDER_MAX_SIZE) {
+        tempd_recorder_rotate();
+        if (rec_file == NULL) {
+            return;
+        }
+    }
+
+    record[n++] = REC_TIME;
+    n += put_varint(&record[n], rec_last_time < 0 ? 0 : now - rec_last_time);
+    rec_last_time = now;
+    tempd_recorder_write(record, n);
+}
+
+void
+tempd_recorder_temp(int id, int temp)
+{
+    uint8_t arg[10];
+    size_t n;
+
+    if (rec_file == NULL || id <= 0 || id > rec_n_ids) {
+        return;
+    }
+    n = put_varint(arg, zigzag((int64_t)temp - rec_temp[id - 1]));
+    tempd_recorder_put(REC_TEMP, id, arg, n);
+    rec_temp[id - 1] = temp;
+    rec_stats.readings++;
+}
+
+void
+tempd_recorder_fault(int id)
+{
+    if (rec_file == NULL) {
+        return;
+    }
+    tempd_recorder_put(REC_FAULT, id, NULL, 0);
+    rec_stats.readings++;
+}
+
+void
+tempd_recorder_state(int id, int status, int fan_speed)
+{
+    uint8_t arg[2];
+
+    arg[0] = status;
+    arg[1] = fan_speed;
+    tempd_recorder_put(REC_STATE, id, arg, sizeof(arg));
+}
+
+void
+tempd_recorder_shutdown(int id)
+{
+    tempd_recorder_put(REC_SHUTDOWN, id, NULL, 0);
+}
+
+// write out buffered records (and, if sync is set, wait for the disk)
+void
+tempd_recorder_flush(bool sync)
+{
+    if (rec_file == NULL) {
+        return;
+    }
+    fflush(rec_file);
+    if (sync) {
+        fsync(fileno(rec_file));
+    }
+}
+
+void
+tempd_recorder_get_stats(struct tempd_recorder_stats *stats)
+{
+    *stats = rec_stats;
+}
@@ -0,0 +1,244 @@
+/*
+ * (c) Copyright 2016 Hewlett Packard Enterprise Development LP
+ *
+ *    Licensed under the Apache License, Version 2.0 (the "License"); you may
+ *    not use this file except in compliance with the License. You may obtain
+ *    a copy of the License at
+ *
+ *         http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *    Unless required by applicable law or agreed to in writing, software
+ *    distributed under the License is distributed on an "AS IS" BASIS, WITHOUT
+ *    WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied. See the
+ *    License for the specific language governing permissions and limitations
+ *    under the License.
+ */
+
+/************************************************************************//**
+ * @ingroup ops-tempd
+ *
+ * @file
+ * Warm-restart state file
+ ***************************************************************************/
+
+#include <errno.h>
+#include <fcntl.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include "util.h"
+#include "openvswitch/vlog.h"
+#include "tempd_state.h"
+
+VLOG_DEFINE_THIS_MODULE(tempd_state);
+
+#define TEMPD_STATE_MIN_RECORDS 64
+
+static int state_fd = -1;
+static struct tempd_state_header *state_header = NULL;
+static size_t state_size = 0;
+// capacity of this process's mapping, in records (bounds checks use this,
+// not the header)
+static uint32_t state_records = 0;
+
+static size_t
+tempd_state_size(uint32_t n_records)
+{
+    return(sizeof(struct tempd_state_header) +
+           n_records * sizeof(struct tempd_state_record));
+}
+
+// (re)map the file at a given capacity
+static int
+tempd_state_map(uint32_t n_records)
+{
+    size_t size = tempd_state_size(n_records);
+    void *addr;
+
+    if (state_header != NULL) {
+        munmap(state_header, state_size);
+        state_header = NULL;
+        state_records = 0;
+    }
+
+    if (ftruncate(state_fd, size) < 0) {
+        return(errno);
+    }
+
+    addr = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_SHARED, state_fd, 0);
+    if (addr == MAP_FAILED) {
+        return(errno);
+    }
+
+    state_header = addr;
+    state_size = size;
+    state_records = n_records;
+    return(0);
+}
+
+// open (or create) the state file. a file that doesn't match the current
+// format is reinitialized. the file is resized and rewritten in place, so
+// only the process holding the ops_tempd lock may have it open.
+int
+tempd_state_open(const char *path)
+{
+    struct tempd_state_header header;
+    struct stat st;
+    bool valid = false;
+    int rc;
+
+    state_fd = open(path, O_RDWR | O_CREAT, 0600);
+    if (state_fd < 0) {
+        rc = errno;
+        VLOG_ERR("Unable to open state file %s (%s)", path, ovs_strerror(rc));
+        return(rc);
+    }
+
+    if (fstat(state_fd, &st) == 0 && st.st_size >= sizeof(header) &&
+            pread(state_fd, &header, sizeof(header), 0) == sizeof(header)) {
+        valid = header.magic == TEMPD_STATE_MAGIC &&
+                header.version == TEMPD_STATE_VERSION &&
+                header.record_size == sizeof(struct tempd_state_record) &&
+                st.st_size >= tempd_state_size(header.n_records);
+        if (!valid) {
+            VLOG_INFO("Discarding state file %s (version %u)", path,
+                      header.version);
+        }
+    }
+
+    if (valid) {
+        rc = tempd_state_map(header.n_records);
+    } else {
+        if (ftruncate(state_fd, 0) < 0) {
+            rc = errno;
+        } else {
+            rc = tempd_state_map(TEMPD_STATE_MIN_RECORDS);
+        }
+        if (rc == 0) {
+            memset(state_header, 0, state_size);
+            state_header->magic = TEMPD_STATE_MAGIC;
+            state_header->version = TEMPD_STATE_VERSION;
+            state_header->record_size = sizeof(struct tempd_state_record);
+            state_header->n_records = TEMPD_STATE_MIN_RECORDS;
+        }
+    }
+
+    if (rc != 0) {
+        VLOG_ERR("Unable to map state file %s (%s)", path, ovs_strerror(rc));
+        tempd_state_close();
+    }
+    return(rc);
+}
+
+void
+tempd_state_close(void)
+{
+    if (state_header != NULL) {
+        munmap(state_header, state_size);
+        state_header = NULL;
+        state_records = 0;
+    }
+    if (state_fd >= 0) {
+        close(state_fd);
+        state_fd = -1;
+    }
+}
+
+// write the state file out to disk now, rather than when the kernel
+// gets to it
+void
+tempd_state_sync(void)
+{
+    if (state_header != NULL) {
+        msync(state_header, state_size, MS_SYNC);
+    }
+}
+
+bool
+tempd_state_is_open(void)
+{
+    return(state_header != NULL);
+}
+
+// note a completed poll (now is the wall clock time, in msec)
+void
+tempd_state_heartbeat(long long int now)
+{
+    if (state_header != NULL) {
+        state_header->heartbeat = now;
+        state_header->polls++;
+    }
+}
+
+struct tempd_state_record *
+tempd_state_record(int slot)
+{
+    struct tempd_state_record *records;
+
+    if (state_header == NULL || slot < 0 || slot >= state_records) {
+        return(NULL);
+    }
+    records = (struct tempd_state_record *)(state_header + 1);
+    return(&records[slot]);
+}
+
+// find the slot for a sensor, allocating one if it has none. the returned
+// slot stays valid (the file may be remapped, so don't keep pointers to
+// records). returns -1 if the state file isn't open.
+int
+tempd_state_slot(const char *name)
+{
+    struct tempd_state_record *rec;
+    char key[TEMPD_STATE_NAME_LEN];
+    uint32_t n_records;
+    int free_slot = -1;
+    int slot;
+
+    if (state_header == NULL) {
+        return(-1);
+    }
+
+    // records hold the name truncated to fit, compare against that
+    ovs_strlcpy(key, name, sizeof(key));
+    n_records = state_records;
+    for (slot = 0; slot < n_records; slot++) {
+        rec = tempd_state_record(slot);
+        if (strncmp(rec->name, key, TEMPD_STATE_NAME_LEN) == 0) {
+            return(slot);
+        }
+        if (free_slot < 0 && rec->name[0] == '\0') {
+            free_slot = slot;
+        }
+    }
+
+    if (free_slot < 0) {
+        // full: double the capacity
+        if (tempd_state_map(n_records * 2) != 0) {
+            VLOG_ERR("Unable to grow state file");
+            tempd_state_close();
+            return(-1);
+        }
+        state_header->n_records = n_records * 2;
+        memset(tempd_state_record(n_records), 0,
+               n_records * sizeof(struct tempd_state_record));
+        free_slot = n_records;
+    }
+
+    rec = tempd_state_record(free_slot);
+    memset(rec, 0, sizeof(*rec));
+    ovs_strlcpy(rec->name, key, TEMPD_STATE_NAME_LEN);
+    return(free_slot);
+}
+
+// release a sensor's slot
+void
+tempd_state_free(int slot)
+{
+    struct tempd_state_record *rec = tempd_state_record(slot);
+
+    if (rec != NULL) {
+        memset(rec, 0, sizeof(*rec));
+    }
+}
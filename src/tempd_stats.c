@@ -0,0 +1,155 @@
+/*
+ * (c) Copyright 2016 Hewlett Packard Enterprise Development LP
+ *
+ *    Licensed under the Apache License, Version 2.0 (the "License"); you may
+ *    not use this file except in compliance with the License. You may obtain
+ *    a copy of the License at
+ *
+ *         http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *    Unless required by applicable law or agreed to in writing, software
+ *    distributed under the License is distributed on an "AS IS" BASIS, WITHOUT
+ *    WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied. See the
+ *    License for the specific language governing permissions and limitations
+ *    under the License.
+ */
+
+/************************************************************************//**
+ * @ingroup ops-tempd
+ *
+ * @file
+ * Rolling-window temperature statistics
+ ***************************************************************************/
+
+#include <limits.h>
+#include <string.h>
+
+#include "tempd_stats.h"
+
+// must match statswindow enum
+static const char *stats_window_names[] = {
+    "1m",
+    "15m",
+    "24h"
+};
+
+// must match statswindow enum (msec)
+static const long long int stats_window_spans[] = {
+    60 * 1000LL,
+    15 * 60 * 1000LL,
+    24 * 60 * 60 * 1000LL
+};
+
+const char *
+stats_window_name(enum statswindow window)
+{
+    return(stats_window_names[window]);
+}
+
+long long int
+stats_window_span(enum statswindow window)
+{
+    return(stats_window_spans[window]);
+}
+
+static void
+stats_bucket_clear(struct stats_bucket *bucket)
+{
+    bucket->min = INT_MAX;
+    bucket->max = INT_MIN;
+    bucket->sum = 0;
+    bucket->count = 0;
+}
+
+void
+stats_window_init(struct stats_window *window, long long int span_msec)
+{
+    int i;
+
+    memset(window, 0, sizeof(*window));
+    window->width = span_msec / STATS_BUCKETS;
+    for (i = 0; i < STATS_BUCKETS; i++) {
+        stats_bucket_clear(&window->buckets[i]);
+    }
+}
+
+// move the window up to the current time, expiring old buckets
+static void
+stats_window_advance(struct stats_window *window, long long int now)
+{
+    long long int epoch = now / window->width;
+    long long int steps = epoch - window->epoch;
+
+    if (steps <= 0) {
+        return;
+    }
+    if (steps > STATS_BUCKETS) {
+        steps = STATS_BUCKETS;
+    }
+
+    while (steps-- > 0) {
+        struct stats_bucket *bucket;
+
+        window->cur = (window->cur + 1) % STATS_BUCKETS;
+        bucket = &window->buckets[window->cur];
+        window->sum -= bucket->sum;
+        window->count -= bucket->count;
+        stats_bucket_clear(bucket);
+    }
+    window->epoch = epoch;
+}
+
+void
+stats_window_add(struct stats_window *window, long long int now, int value)
+{
+    struct stats_bucket *bucket;
+
+    stats_window_advance(window, now);
+
+    bucket = &window->buckets[window->cur];
+    if (value < bucket->min) {
+        bucket->min = value;
+    }
+    if (value > bucket->max) {
+        bucket->max = value;
+    }
+    bucket->sum += value;
+    bucket->count++;
+    window->sum += value;
+    window->count++;
+}
+
+// get the window's statistics. returns false if there are no samples.
+bool
+stats_window_get(struct stats_window *window, long long int now,
+                 struct stats_result *result)
+{
+    int i;
+
+    stats_window_advance(window, now);
+
+    result->count = window->count;
+    if (window->count == 0) {
+        result->min = result->max = result->avg = 0;
+        return(false);
+    }
+
+    result->min = INT_MAX;
+    result->max = INT_MIN;
+    for (i = 0; i < STATS_BUCKETS; i++) {
+        const struct stats_bucket *bucket = &window->buckets[i];
+
+        if (bucket->count == 0) {
+            continue;
+        }
+        if (bucket->min < result->min) {
+            result->min = bucket->min;
+        }
+        if (bucket->max > result->max) {
+            result->max = bucket->max;
+        }
+    }
+    result->avg = window->sum / window->count;
+
+    return(true);
+}